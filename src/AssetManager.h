@@ -0,0 +1,403 @@
+#pragma once
+#include "raylib.h"
+#include "Components.h"
+#include "OBJLoader.h"
+#include "Texture.h"
+#include "Meshlets.h"
+#include "VertexQuantization.h"
+#include "VirtualTexture.h"
+#include <string>
+#include <vector>
+#include <deque>
+#include <queue>
+#include <memory>
+#include <unordered_map>
+#include <cstdint>
+#include <algorithm>
+
+#ifndef __EMSCRIPTEN__
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#endif
+
+enum class AssetState {
+    Loading,    // Queued or decoding; handles resolve to the placeholder
+    Ready,
+    Failed      // Keeps resolving to the placeholder
+};
+
+template <typename T>
+struct AssetSlot {
+    std::string path;
+    const T* current = nullptr;      // What handles resolve to; only AssetManager::Update changes it
+    std::unique_ptr<T> loaded;
+    AssetState state = AssetState::Loading;
+};
+
+// Cheap to copy; resolves to the placeholder until the asset is published, then to the
+// asset. A default-constructed handle resolves to nullptr and has an empty path.
+template <typename T>
+class AssetHandle {
+public:
+    AssetHandle() = default;
+
+    const T* Get() const { return slot ? slot->current : nullptr; }
+    AssetState GetState() const { return slot ? slot->state : AssetState::Failed; }
+    const std::string& GetPath() const {
+        static const std::string none;
+        return slot ? slot->path : none;
+    }
+    explicit operator bool() const { return slot != nullptr; }
+
+private:
+    friend class AssetManager;
+    explicit AssetHandle(AssetSlot<T>* slot) : slot(slot) {}
+    AssetSlot<T>* slot = nullptr;
+};
+
+using MeshHandle = AssetHandle<MeshS>;
+using TextureHandle = AssetHandle<TextureS>;
+
+// Decodes OBJ meshes and textures on background threads, highest priority first.
+// Finished assets are only published by Update, which the main thread calls between
+// frames, so every draw of a frame sees the same version of every asset. Placeholders and
+// loaded assets live as long as the manager, so a frame still in flight never reads
+// freed data when a handle switches over.
+class AssetManager {
+public:
+    explicit AssetManager(unsigned int loaderThreads = 2) {
+        placeholderMesh = MakePlaceholderMesh();
+        placeholderTexture = MakePlaceholderTexture();
+#ifndef __EMSCRIPTEN__
+        for (unsigned int i = 0; i < std::max(1u, loaderThreads); i++) {
+            loaders.emplace_back([this] { LoaderLoop(); });
+        }
+#else
+        (void)loaderThreads;
+#endif
+    }
+
+    ~AssetManager() {
+#ifndef __EMSCRIPTEN__
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            stop = true;
+        }
+        requestCondition.notify_all();
+        for (auto& loader : loaders) {
+            loader.join();
+        }
+#endif
+        for (auto& slot : textureSlots) {
+            if (slot.loaded) slot.loaded->Unload();
+        }
+        for (auto& done : completedTextures) {
+            if (done.second) done.second->Unload();
+        }
+        placeholderTexture.Unload();
+    }
+
+    // Higher priorities are decoded first; equal priorities in request order. Asking for
+    // a path again returns the existing handle.
+    MeshHandle LoadMesh(const std::string& path, int priority = 0) {
+        return MeshHandle(Request(meshSlots, meshesByPath, path, priority, &placeholderMesh));
+    }
+
+    // A .vtex path opens a virtual texture, paged in as the renderer samples it
+    TextureHandle LoadTexture(const std::string& path, int priority = 0) {
+        return TextureHandle(Request(textureSlots, texturesByPath, path, priority, &placeholderTexture));
+    }
+
+    // Registers an asset that is already in memory; its handle is ready immediately
+    MeshHandle AddMesh(MeshS mesh) {
+        BuildMeshlets(mesh);
+        if (vertexQuantization.enabled) QuantizeVertices(mesh, vertexQuantization.normals, vertexQuantization.uvs);
+        return MeshHandle(AddResident(meshSlots, std::make_unique<MeshS>(std::move(mesh))));
+    }
+
+    TextureHandle AddTexture(TextureS texture) {
+        return TextureHandle(AddResident(textureSlots, std::make_unique<TextureS>(texture)));
+    }
+
+    // Publishes everything that finished decoding since the last call. Call on the main
+    // thread between frames, never while a frame is being recorded. Returns how many
+    // handles changed what they resolve to.
+    int Update() {
+#ifndef __EMSCRIPTEN__
+        std::vector<std::pair<AssetSlot<MeshS>*, std::unique_ptr<MeshS>>> meshes;
+        std::vector<std::pair<AssetSlot<TextureS>*, std::unique_ptr<TextureS>>> textures;
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            meshes.swap(completedMeshes);
+            textures.swap(completedTextures);
+        }
+        int published = Publish(meshes) + Publish(textures);
+#else
+        // No loader threads: publish last call's result, then decode one request so the
+        // cost is spread one asset per frame
+        int published = Publish(completedMeshes) + Publish(completedTextures);
+        completedMeshes.clear();
+        completedTextures.clear();
+        if (!requests.empty()) {
+            LoadRequest request = requests.top();
+            requests.pop();
+            Decode(request);
+        }
+#endif
+        return published;
+    }
+
+    // Blocks until every request so far has been decoded; Update still has to publish them
+    void WaitAll() {
+#ifndef __EMSCRIPTEN__
+        std::unique_lock<std::mutex> lock(queueMutex);
+        idleCondition.wait(lock, [this] { return requests.empty() && decoding == 0; });
+#else
+        while (!requests.empty()) {
+            LoadRequest request = requests.top();
+            requests.pop();
+            Decode(request);
+        }
+#endif
+    }
+
+    // Requests not yet published
+    int GetPendingCount() const { return pending; }
+
+    // Textures requested from now on are kept BC1-compressed in memory
+    void SetTextureCompression(bool enabled) { compressTextures = enabled; }
+    bool IsTextureCompressionEnabled() const { return compressTextures; }
+
+    // Memory held by published textures, placeholders excluded
+    size_t GetTextureMemory() const {
+        size_t bytes = 0;
+        for (const auto& slot : textureSlots) {
+            if (!slot.loaded) continue;
+            bytes += slot.loaded->GetMemoryBytes();
+            if (slot.loaded->virtualTexture) bytes += slot.loaded->virtualTexture->GetMemoryBytes();
+        }
+        return bytes;
+    }
+
+    // Page cache size of virtual textures requested from now on, in pages of each
+    void SetVirtualTextureCache(int pages) { virtualTextureCachePages = pages; }
+    int GetVirtualTextureCache() const { return virtualTextureCachePages; }
+
+    // Meshes requested or added from now on are packed by QuantizeVertices
+    void SetVertexQuantization(const VertexQuantization& quantization) { vertexQuantization = quantization; }
+    const VertexQuantization& GetVertexQuantization() const { return vertexQuantization; }
+
+    // Vertex memory held by published meshes, placeholders excluded
+    size_t GetMeshMemory() const {
+        size_t bytes = 0;
+        for (const auto& slot : meshSlots) {
+            if (slot.loaded) bytes += slot.loaded->GetVertexMemoryBytes();
+        }
+        return bytes;
+    }
+
+private:
+    struct LoadRequest {
+        int priority;
+        uint64_t sequence;
+        AssetSlot<MeshS>* mesh;
+        AssetSlot<TextureS>* texture;
+        bool compress;
+        VertexQuantization quantization;
+        int virtualCachePages;
+
+        bool operator<(const LoadRequest& other) const {
+            if (priority != other.priority) return priority < other.priority;
+            return sequence > other.sequence;
+        }
+    };
+
+    template <typename T>
+    AssetSlot<T>* Request(std::deque<AssetSlot<T>>& slots, std::unordered_map<std::string, AssetSlot<T>*>& byPath,
+                          const std::string& path, int priority, const T* placeholder) {
+        auto found = byPath.find(path);
+        if (found != byPath.end()) return found->second;
+
+        slots.emplace_back();
+        AssetSlot<T>* slot = &slots.back();
+        slot->path = path;
+        slot->current = placeholder;
+        byPath[path] = slot;
+        pending++;
+
+        LoadRequest request = {priority, nextSequence++, nullptr, nullptr, compressTextures, vertexQuantization,
+                               virtualTextureCachePages};
+        SetTarget(request, slot);
+#ifndef __EMSCRIPTEN__
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            requests.push(request);
+        }
+        requestCondition.notify_one();
+#else
+        requests.push(request);
+#endif
+        return slot;
+    }
+
+    template <typename T>
+    AssetSlot<T>* AddResident(std::deque<AssetSlot<T>>& slots, std::unique_ptr<T> asset) {
+        slots.emplace_back();
+        AssetSlot<T>* slot = &slots.back();
+        slot->loaded = std::move(asset);
+        slot->current = slot->loaded.get();
+        slot->state = AssetState::Ready;
+        return slot;
+    }
+
+    static void SetTarget(LoadRequest& request, AssetSlot<MeshS>* slot) { request.mesh = slot; }
+    static void SetTarget(LoadRequest& request, AssetSlot<TextureS>* slot) { request.texture = slot; }
+
+    template <typename T>
+    int Publish(std::vector<std::pair<AssetSlot<T>*, std::unique_ptr<T>>>& done) {
+        int published = 0;
+        for (auto& result : done) {
+            AssetSlot<T>* slot = result.first;
+            pending--;
+            if (!result.second) {
+                slot->state = AssetState::Failed;
+                TraceLog(LOG_WARNING, "ASSETS: Failed to load %s, keeping placeholder", slot->path.c_str());
+                continue;
+            }
+            slot->loaded = std::move(result.second);
+            slot->current = slot->loaded.get();
+            slot->state = AssetState::Ready;
+            published++;
+        }
+        return published;
+    }
+
+    // Runs on a loader thread; touches nothing shared until the result is queued
+    void Decode(const LoadRequest& request) {
+        if (request.mesh) {
+            std::unique_ptr<MeshS> mesh(new MeshS());
+            if (!ObjLoader::LoadOBJ(request.mesh->path, *mesh)) mesh.reset();
+            else {
+                BuildMeshlets(*mesh);
+                const VertexQuantization& quantization = request.quantization;
+                if (quantization.enabled) QuantizeVertices(*mesh, quantization.normals, quantization.uvs);
+            }
+            Complete(completedMeshes, request.mesh, std::move(mesh));
+        } else {
+            const std::string& path = request.texture->path;
+            std::unique_ptr<TextureS> texture(new TextureS());
+            if (IsVirtualTexturePath(path)) {
+                texture->virtualTexture = VirtualTexture::Open(path, request.virtualCachePages);
+                if (!texture->virtualTexture) texture.reset();
+            } else if (!texture->Load(path)) {
+                texture.reset();
+            } else if (request.compress) {
+                texture->Compress();
+            }
+            Complete(completedTextures, request.texture, std::move(texture));
+        }
+    }
+
+    template <typename T>
+    void Complete(std::vector<std::pair<AssetSlot<T>*, std::unique_ptr<T>>>& done, AssetSlot<T>* slot,
+                  std::unique_ptr<T> asset) {
+#ifndef __EMSCRIPTEN__
+        std::unique_lock<std::mutex> lock(queueMutex);
+#endif
+        done.emplace_back(slot, std::move(asset));
+    }
+
+#ifndef __EMSCRIPTEN__
+    void LoaderLoop() {
+        while (true) {
+            LoadRequest request;
+            {
+                std::unique_lock<std::mutex> lock(queueMutex);
+                requestCondition.wait(lock, [this] { return stop || !requests.empty(); });
+                if (stop) return;
+                request = requests.top();
+                requests.pop();
+                decoding++;
+            }
+
+            Decode(request);
+
+            {
+                std::unique_lock<std::mutex> lock(queueMutex);
+                decoding--;
+            }
+            idleCondition.notify_all();
+        }
+    }
+#endif
+
+    // A unit cube with per-face normals, roughly the size of the demo models
+    static MeshS MakePlaceholderMesh() {
+        static const Vector3S normals[6] = {{1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}};
+        MeshS mesh;
+        for (int face = 0; face < 6; face++) {
+            Vector3S n = normals[face];
+            // Two axes spanning the face with s x t = n, so the corners wind counter-clockwise
+            Vector3S s = {n.y, n.z, n.x};
+            Vector3S t = Vector3Cross(n, s);
+            int base = (int)mesh.vertices.size();
+            const float corners[4][2] = {{-1, -1}, {1, -1}, {1, 1}, {-1, 1}};
+            for (int c = 0; c < 4; c++) {
+                Vertex v;
+                v.position = Vector3Scale(Vector3Add(n, Vector3Add(Vector3Scale(s, corners[c][0]), Vector3Scale(t, corners[c][1]))), 0.5f);
+                v.normal = n;
+                v.uv = {(corners[c][0] + 1) * 0.5f, (corners[c][1] + 1) * 0.5f};
+                mesh.vertices.push_back(v);
+            }
+            const int order[6] = {0, 1, 2, 0, 2, 3};
+            for (int i : order) {
+                mesh.indices.push_back(base + i);
+            }
+        }
+        BuildMeshlets(mesh);
+        return mesh;
+    }
+
+    // Grey checkerboard, so untextured-looking objects read as "still loading"
+    static TextureS MakePlaceholderTexture() {
+        TextureS texture;
+        texture.width = 8;
+        texture.height = 8;
+        texture.pixels = new Color[64];
+        for (int y = 0; y < 8; y++) {
+            for (int x = 0; x < 8; x++) {
+                unsigned char v = ((x ^ y) & 1) ? 200 : 120;
+                texture.pixels[y * 8 + x] = {v, v, v, 255};
+            }
+        }
+        return texture;
+    }
+
+    MeshS placeholderMesh;
+    TextureS placeholderTexture;
+
+    // Slots are only created and published on the main thread; deques keep them in place
+    std::deque<AssetSlot<MeshS>> meshSlots;
+    std::deque<AssetSlot<TextureS>> textureSlots;
+    std::unordered_map<std::string, AssetSlot<MeshS>*> meshesByPath;
+    std::unordered_map<std::string, AssetSlot<TextureS>*> texturesByPath;
+    uint64_t nextSequence = 0;
+    int pending = 0;
+    bool compressTextures = false;
+    VertexQuantization vertexQuantization;
+    int virtualTextureCachePages = 256;
+
+    std::priority_queue<LoadRequest> requests;
+    std::vector<std::pair<AssetSlot<MeshS>*, std::unique_ptr<MeshS>>> completedMeshes;
+    std::vector<std::pair<AssetSlot<TextureS>*, std::unique_ptr<TextureS>>> completedTextures;
+
+#ifndef __EMSCRIPTEN__
+    std::vector<std::thread> loaders;
+    std::mutex queueMutex;
+    std::condition_variable requestCondition;
+    std::condition_variable idleCondition;
+    int decoding = 0;
+    bool stop = false;
+#endif
+};
@@ -7,4 +7,11 @@ struct CameraS {
     float fov = 90.0f;
     float yaw = 0.0f;    // Horizontal rotation (radians)
     float pitch = 0.0f;  // Vertical rotation (radians)
+};
+
+// A camera drawing into a sub-rectangle of the output, in output pixels
+struct ViewS {
+    CameraS camera;
+    int x = 0, y = 0;
+    int width = 0, height = 0;
 };
\ No newline at end of file
@@ -0,0 +1,36 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <cstddef>
+
+// Append-only storage in fixed-size chunks. Elements never move once allocated, and
+// Reset is O(1) and keeps every chunk, so after the first few frames have reached the
+// high-water mark nothing is allocated at all.
+template <typename T, size_t ChunkSize>
+class ChunkedArena {
+public:
+    size_t Allocate() {
+        if (count == chunks.size() * ChunkSize) {
+            chunks.emplace_back(new T[ChunkSize]);
+        }
+        return count++;
+    }
+
+    T& operator[](size_t index) { return chunks[index / ChunkSize][index % ChunkSize]; }
+    const T& operator[](size_t index) const { return chunks[index / ChunkSize][index % ChunkSize]; }
+
+    void Reset() {
+        highWater = std::max(highWater, count);
+        count = 0;
+    }
+
+    size_t Size() const { return count; }
+    size_t Capacity() const { return chunks.size() * ChunkSize; }
+    size_t HighWater() const { return std::max(highWater, count); }
+
+private:
+    std::vector<std::unique_ptr<T[]>> chunks;
+    size_t count = 0;
+    size_t highWater = 0;
+};
@@ -1,5 +1,6 @@
 #pragma once
 #include <vector>
+#include <cstdint>
 #include "MathS.h"
 
 struct Vertex {
@@ -14,7 +15,76 @@ struct TransformS {
     Vector3S scale = {1, 1, 1};
 };
 
+// A cluster of up to kMeshletMaxTriangles consecutive triangles, with object-space
+// bounds for rejecting it before any of its vertices are transformed
+struct Meshlet {
+    uint32_t vertexOffset;       // Into MeshS::meshletVertices
+    uint32_t triangleOffset;     // Into MeshS::meshletTriangles, three entries per triangle
+    uint8_t vertexCount;
+    uint8_t triangleCount;
+    Vector3S center;             // Bounding sphere
+    float radius;
+    // Normal cone: every triangle faces away from a camera whose direction to the apex is
+    // within acos(coneCutoff) of the axis. Above 1 when the normals spread too far.
+    Vector3S coneApex;
+    Vector3S coneAxis;
+    float coneCutoff;
+};
+
+// Linear-blend skin binding of one vertex: up to four joints, weights summing to 1
+struct SkinWeights {
+    uint8_t joints[4];           // Below the mesh's inverseBindMatrices.size()
+    float weights[4];
+};
+
+// Blend shape stored sparsely: offsets for the vertices it moves, in ascending order
+struct MorphTarget {
+    std::vector<uint32_t> vertices;
+    std::vector<Vector3S> positionDeltas;
+    std::vector<Vector3S> normalDeltas;      // Empty if the target leaves normals alone
+};
+
+enum class NormalEncoding {
+    Oct16,      // Octahedral, two 16-bit snorms
+    Oct8        // Octahedral, two 8-bit snorms
+};
+
+enum class UVEncoding {
+    Unorm16,    // 16-bit unorm over the mesh's UV bounds
+    Half        // Half floats; unbounded, but coarser away from 0
+};
+
+// Vertex attributes quantized into separate streams, built by QuantizeVertices. A mesh
+// that has them keeps no float vertices.
+struct PackedVertices {
+    uint32_t count = 0;
+    std::vector<uint16_t> positions;      // Three per vertex: unorm over the mesh bounds
+    std::vector<uint8_t> normals;         // Two snorms per vertex, of 1 or 2 bytes each
+    std::vector<uint16_t> uvs;            // Two per vertex
+    Vector3S positionMin = {0, 0, 0};     // position = positionMin + q * positionScale
+    Vector3S positionScale = {0, 0, 0};
+    Vector2S uvMin = {0, 0};              // Unorm16 only, as for positions
+    Vector2S uvScale = {0, 0};
+    NormalEncoding normalEncoding = NormalEncoding::Oct16;
+    UVEncoding uvEncoding = UVEncoding::Unorm16;
+};
+
 struct MeshS {
-    std::vector<Vertex> vertices;
+    std::vector<Vertex> vertices;           // Empty when the mesh is packed
     std::vector<int> indices;
+    // Built by BuildMeshlets; the triangles are the indices' triangles, in the same order
+    std::vector<Meshlet> meshlets;
+    std::vector<uint32_t> meshletVertices;   // Mesh vertex index of each meshlet-local vertex
+    std::vector<uint8_t> meshletTriangles;   // Meshlet-local vertex indices
+    // Skinning, used when skin has one entry per vertex; joints are posed per object
+    std::vector<SkinWeights> skin;
+    std::vector<Matrix4x4> inverseBindMatrices;   // Per joint: mesh space to joint space
+    std::vector<MorphTarget> morphTargets;
+    PackedVertices packed;
+
+    size_t GetVertexCount() const { return packed.count ? packed.count : vertices.size(); }
+    size_t GetVertexMemoryBytes() const {
+        return vertices.size() * sizeof(Vertex) + packed.positions.size() * sizeof(uint16_t) +
+               packed.normals.size() + packed.uvs.size() * sizeof(uint16_t);
+    }
 };
\ No newline at end of file
@@ -0,0 +1,451 @@
+#pragma once
+#include "raylib.h"
+#include "MathS.h"
+#include "Components.h"
+#include "Texture.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// AVX2 and AVX-512 variants are compiled with per-function target attributes and only
+// called after cpuid says they run; the rest of the program stays at the baseline ISA
+#if !defined(__EMSCRIPTEN__) && (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define CPU_DISPATCH_X86 1
+#include <immintrin.h>
+#define KERNEL_AVX2 __attribute__((target("avx2")))
+#define KERNEL_AVX512 __attribute__((target("avx2,avx512f")))
+#endif
+
+// Every level computes each value with the same operations in the same order, so all of
+// them render bit-identical frames. That relies on the compiler not fusing multiplies
+// and adds into FMAs, which the build turns off.
+enum class CpuLevel {
+    Scalar,
+    SSE2,
+    AVX2,
+    AVX512
+};
+
+static const char* const kCpuLevelEnvironment = "RENDERER_CPU";
+
+// A triangle's edge functions and depth along one row, at the column of the planes' origin.
+// depth[0] belongs to the pixel offset columns right of it.
+struct CoverageRow {
+    float edge[3];
+    float edgeDx[3];
+    float depth;
+    float depthDx;
+    int offset;
+};
+
+// The hot loops, one implementation per level
+struct CpuKernels {
+    CpuLevel level;
+    // Bit i set when pixel first + i of the row is inside all three edges and nearer than
+    // depth[first + i]. Edges and depth are evaluated as value + dx * (offset + first + i),
+    // so a pixel's result does not depend on where the row was cut. count <= 64.
+    uint64_t (*coverage)(const CoverageRow& row, const float* depth, int first, int count);
+    BilinearFilterFn bilinear;
+    // out[i] = the clip-space position of vertices[indices[i]]
+    void (*transformPoints)(const Vertex* vertices, const uint32_t* indices, int count, const Matrix4x4& m, Vector4S* out);
+    // The same for packed positions, three unorm16 per vertex; m takes them as floats
+    void (*transformPackedPoints)(const uint16_t* positions, const uint32_t* indices, int count, const Matrix4x4& m, Vector4S* out);
+    void (*fillColor)(Color* dst, size_t count, Color value);
+    void (*fillDepth)(float* dst, size_t count, float value);
+    // Box filter of 4 samples per pixel, rounded to nearest
+    void (*resolve4x)(const Color* samples, Color* out, int pixels);
+};
+
+// Index of the lowest set bit; mask must not be zero
+inline int LowestBit(uint64_t mask) {
+#if defined(__GNUC__)
+    return __builtin_ctzll(mask);
+#else
+    int index = 0;
+    while (!(mask & 1)) {
+        mask >>= 1;
+        index++;
+    }
+    return index;
+#endif
+}
+
+// The object-space point a transform kernel reads: a float vertex's position, or a
+// packed position still in quantized units
+inline Vector3S PointAt(const Vertex* vertices, uint32_t index) {
+    return vertices[index].position;
+}
+
+inline Vector3S PointAt(const uint16_t* positions, uint32_t index) {
+    const uint16_t* q = positions + (size_t)index * 3;
+    return {(float)q[0], (float)q[1], (float)q[2]};
+}
+
+// --- Scalar ---
+
+static inline uint64_t CoverageScalar(const CoverageRow& row, const float* depth, int first, int count) {
+    uint64_t mask = 0;
+    for (int i = 0; i < count; i++) {
+        float x = (float)(row.offset + first + i);
+        if (row.edge[0] + row.edgeDx[0] * x >= 0 && row.edge[1] + row.edgeDx[1] * x >= 0 &&
+            row.edge[2] + row.edgeDx[2] * x >= 0 && row.depth + row.depthDx * x < depth[first + i]) {
+            mask |= (uint64_t)1 << i;
+        }
+    }
+    return mask;
+}
+
+template <typename Points>
+static inline void TransformPointsScalar(Points points, const uint32_t* indices, int count, const Matrix4x4& m, Vector4S* out) {
+    for (int i = 0; i < count; i++) {
+        out[i] = MultiplyVectorMatrix4(PointAt(points, indices[i]), m);
+    }
+}
+
+template <typename T>
+static inline void FillScalar(T* dst, size_t count, T value) {
+    std::fill(dst, dst + count, value);
+}
+
+static inline void Resolve4xScalar(const Color* samples, Color* out, int pixels) {
+    for (int p = 0; p < pixels; p++, samples += 4) {
+        out[p] = {
+            (unsigned char)((samples[0].r + samples[1].r + samples[2].r + samples[3].r + 2) / 4),
+            (unsigned char)((samples[0].g + samples[1].g + samples[2].g + samples[3].g + 2) / 4),
+            (unsigned char)((samples[0].b + samples[1].b + samples[2].b + samples[3].b + 2) / 4),
+            (unsigned char)((samples[0].a + samples[1].a + samples[2].a + samples[3].a + 2) / 4)
+        };
+    }
+}
+
+// --- SSE2 ---
+
+#if defined(__SSE2__)
+static inline uint64_t CoverageSSE2(const CoverageRow& row, const float* depth, int first, int count) {
+    const __m128 lanes = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 e0 = _mm_set1_ps(row.edge[0]), e1 = _mm_set1_ps(row.edge[1]), e2 = _mm_set1_ps(row.edge[2]);
+    const __m128 dx0 = _mm_set1_ps(row.edgeDx[0]), dx1 = _mm_set1_ps(row.edgeDx[1]), dx2 = _mm_set1_ps(row.edgeDx[2]);
+    const __m128 z = _mm_set1_ps(row.depth), dz = _mm_set1_ps(row.depthDx);
+    uint64_t mask = 0;
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 x = _mm_add_ps(_mm_set1_ps((float)(row.offset + first + i)), lanes);
+        __m128 inside = _mm_cmpge_ps(_mm_add_ps(e0, _mm_mul_ps(dx0, x)), zero);
+        inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(e1, _mm_mul_ps(dx1, x)), zero));
+        inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(e2, _mm_mul_ps(dx2, x)), zero));
+        inside = _mm_and_ps(inside, _mm_cmplt_ps(_mm_add_ps(z, _mm_mul_ps(dz, x)), _mm_loadu_ps(depth + first + i)));
+        mask |= (uint64_t)_mm_movemask_ps(inside) << i;
+    }
+    if (i < count) mask |= CoverageScalar(row, depth, first + i, count - i) << i;
+    return mask;
+}
+
+static inline __m128 ColorToFloatSSE2(Color c) {
+    uint32_t bits;
+    memcpy(&bits, &c, sizeof(bits));
+    __m128i v = _mm_unpacklo_epi8(_mm_cvtsi32_si128((int)bits), _mm_setzero_si128());
+    return _mm_cvtepi32_ps(_mm_unpacklo_epi16(v, _mm_setzero_si128()));
+}
+
+static inline Color FloatToColorSSE2(__m128 v) {
+    __m128i i = _mm_cvttps_epi32(v);
+    i = _mm_packs_epi32(i, i);
+    uint32_t bits = (uint32_t)_mm_cvtsi128_si32(_mm_packus_epi16(i, i));
+    Color c;
+    memcpy(&c, &bits, sizeof(c));
+    c.a = 255;
+    return c;
+}
+
+static inline Color BilinearFilterSSE2(Color c00, Color c10, Color c01, Color c11, float tx, float ty) {
+    __m128 left = _mm_set1_ps(1 - tx), right = _mm_set1_ps(tx);
+    __m128 top = _mm_add_ps(_mm_mul_ps(ColorToFloatSSE2(c00), left), _mm_mul_ps(ColorToFloatSSE2(c10), right));
+    __m128 bottom = _mm_add_ps(_mm_mul_ps(ColorToFloatSSE2(c01), left), _mm_mul_ps(ColorToFloatSSE2(c11), right));
+    return FloatToColorSSE2(_mm_add_ps(_mm_mul_ps(top, _mm_set1_ps(1 - ty)), _mm_mul_ps(bottom, _mm_set1_ps(ty))));
+}
+
+template <typename Points>
+static inline void TransformPointsSSE2(Points points, const uint32_t* indices, int count, const Matrix4x4& m, Vector4S* out) {
+    const __m128 r0 = _mm_loadu_ps(m.m[0]), r1 = _mm_loadu_ps(m.m[1]), r2 = _mm_loadu_ps(m.m[2]), r3 = _mm_loadu_ps(m.m[3]);
+    for (int i = 0; i < count; i++) {
+        const Vector3S p = PointAt(points, indices[i]);
+        __m128 v = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(p.x), r0), _mm_mul_ps(_mm_set1_ps(p.y), r1));
+        v = _mm_add_ps(_mm_add_ps(v, _mm_mul_ps(_mm_set1_ps(p.z), r2)), r3);
+        _mm_storeu_ps(&out[i].x, v);
+    }
+}
+
+template <typename T>
+static inline void FillSSE2(T* dst, size_t count, T value) {
+    static_assert(sizeof(T) == 4, "Fills are of 32-bit values");
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    const __m128i v = _mm_set1_epi32((int)bits);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) _mm_storeu_si128((__m128i*)(dst + i), v);
+    for (; i < count; i++) dst[i] = value;
+}
+
+// Two pixels of 4 samples each in, their 16-bit channel sums out, pixel0's in the low half
+static inline __m128i SumSamplesSSE2(__m128i pixel0, __m128i pixel1) {
+    const __m128i zero = _mm_setzero_si128();
+    __m128i s0 = _mm_add_epi16(_mm_unpacklo_epi8(pixel0, zero), _mm_unpackhi_epi8(pixel0, zero));
+    __m128i s1 = _mm_add_epi16(_mm_unpacklo_epi8(pixel1, zero), _mm_unpackhi_epi8(pixel1, zero));
+    return _mm_add_epi16(_mm_unpacklo_epi64(s0, s1), _mm_unpackhi_epi64(s0, s1));
+}
+
+static inline void Resolve4xSSE2(const Color* samples, Color* out, int pixels) {
+    const __m128i two = _mm_set1_epi16(2);
+    const __m128i* src = (const __m128i*)samples;
+    int p = 0;
+    for (; p + 4 <= pixels; p += 4, src += 4) {
+        __m128i a = SumSamplesSSE2(_mm_loadu_si128(src), _mm_loadu_si128(src + 1));
+        __m128i b = SumSamplesSSE2(_mm_loadu_si128(src + 2), _mm_loadu_si128(src + 3));
+        a = _mm_srli_epi16(_mm_add_epi16(a, two), 2);
+        b = _mm_srli_epi16(_mm_add_epi16(b, two), 2);
+        _mm_storeu_si128((__m128i*)(out + p), _mm_packus_epi16(a, b));
+    }
+    Resolve4xScalar(samples + p * 4, out + p, pixels - p);
+}
+#endif
+
+// --- AVX2 ---
+
+#if defined(CPU_DISPATCH_X86)
+KERNEL_AVX2 static inline uint64_t CoverageAVX2(const CoverageRow& row, const float* depth, int first, int count) {
+    const __m256 lanes = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 e0 = _mm256_set1_ps(row.edge[0]), e1 = _mm256_set1_ps(row.edge[1]), e2 = _mm256_set1_ps(row.edge[2]);
+    const __m256 dx0 = _mm256_set1_ps(row.edgeDx[0]), dx1 = _mm256_set1_ps(row.edgeDx[1]), dx2 = _mm256_set1_ps(row.edgeDx[2]);
+    const __m256 z = _mm256_set1_ps(row.depth), dz = _mm256_set1_ps(row.depthDx);
+    uint64_t mask = 0;
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 x = _mm256_add_ps(_mm256_set1_ps((float)(row.offset + first + i)), lanes);
+        __m256 inside = _mm256_cmp_ps(_mm256_add_ps(e0, _mm256_mul_ps(dx0, x)), zero, _CMP_GE_OQ);
+        inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(e1, _mm256_mul_ps(dx1, x)), zero, _CMP_GE_OQ));
+        inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(e2, _mm256_mul_ps(dx2, x)), zero, _CMP_GE_OQ));
+        inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(z, _mm256_mul_ps(dz, x)),
+                                                     _mm256_loadu_ps(depth + first + i), _CMP_LT_OQ));
+        mask |= (uint64_t)_mm256_movemask_ps(inside) << i;
+    }
+    if (i < count) mask |= CoverageSSE2(row, depth, first + i, count - i) << i;
+    return mask;
+}
+
+// Both rows at once: the low half blends the top taps, the high half the bottom ones
+KERNEL_AVX2 static inline Color BilinearFilterAVX2(Color c00, Color c10, Color c01, Color c11, float tx, float ty) {
+    uint32_t bits[4];
+    memcpy(&bits[0], &c00, 4);
+    memcpy(&bits[1], &c01, 4);
+    memcpy(&bits[2], &c10, 4);
+    memcpy(&bits[3], &c11, 4);
+    __m256 left = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_setr_epi32((int)bits[0], (int)bits[1], 0, 0)));
+    __m256 right = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_setr_epi32((int)bits[2], (int)bits[3], 0, 0)));
+    __m256 rows = _mm256_add_ps(_mm256_mul_ps(left, _mm256_set1_ps(1 - tx)), _mm256_mul_ps(right, _mm256_set1_ps(tx)));
+    float inv = 1 - ty;
+    rows = _mm256_mul_ps(rows, _mm256_setr_ps(inv, inv, inv, inv, ty, ty, ty, ty));
+    return FloatToColorSSE2(_mm_add_ps(_mm256_castps256_ps128(rows), _mm256_extractf128_ps(rows, 1)));
+}
+
+// Two points per register, one per 128-bit lane
+template <typename Points>
+KERNEL_AVX2 static inline void TransformPointsAVX2(Points points, const uint32_t* indices, int count, const Matrix4x4& m, Vector4S* out) {
+    const __m256 r0 = _mm256_broadcast_ps((const __m128*)m.m[0]), r1 = _mm256_broadcast_ps((const __m128*)m.m[1]);
+    const __m256 r2 = _mm256_broadcast_ps((const __m128*)m.m[2]), r3 = _mm256_broadcast_ps((const __m128*)m.m[3]);
+    int i = 0;
+    for (; i + 2 <= count; i += 2) {
+        const Vector3S a = PointAt(points, indices[i]);
+        const Vector3S b = PointAt(points, indices[i + 1]);
+        __m256 v = _mm256_add_ps(_mm256_mul_ps(_mm256_setr_ps(a.x, a.x, a.x, a.x, b.x, b.x, b.x, b.x), r0),
+                                 _mm256_mul_ps(_mm256_setr_ps(a.y, a.y, a.y, a.y, b.y, b.y, b.y, b.y), r1));
+        v = _mm256_add_ps(_mm256_add_ps(v, _mm256_mul_ps(_mm256_setr_ps(a.z, a.z, a.z, a.z, b.z, b.z, b.z, b.z), r2)), r3);
+        _mm256_storeu_ps(&out[i].x, v);
+    }
+    TransformPointsSSE2(points, indices + i, count - i, m, out + i);
+}
+
+template <typename T>
+KERNEL_AVX2 static inline void FillAVX2(T* dst, size_t count, T value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    const __m256i v = _mm256_set1_epi32((int)bits);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) _mm256_storeu_si256((__m256i*)(dst + i), v);
+    FillSSE2(dst + i, count - i, value);
+}
+
+// SumSamplesSSE2 per 128-bit lane, rounded and divided: a holds pixels 0 and 1, b 2 and 3;
+// the result holds 0 and 2 in the low lane, 1 and 3 in the high one
+KERNEL_AVX2 static inline __m256i AverageSamplesAVX2(__m256i a, __m256i b) {
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i sa = _mm256_add_epi16(_mm256_unpacklo_epi8(a, zero), _mm256_unpackhi_epi8(a, zero));
+    __m256i sb = _mm256_add_epi16(_mm256_unpacklo_epi8(b, zero), _mm256_unpackhi_epi8(b, zero));
+    __m256i total = _mm256_add_epi16(_mm256_unpacklo_epi64(sa, sb), _mm256_unpackhi_epi64(sa, sb));
+    return _mm256_srli_epi16(_mm256_add_epi16(total, _mm256_set1_epi16(2)), 2);
+}
+
+// The lanes hold alternate pixels, which the final permute puts back in order
+KERNEL_AVX2 static inline void Resolve4xAVX2(const Color* samples, Color* out, int pixels) {
+    const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+    const __m256i* src = (const __m256i*)samples;
+    int p = 0;
+    for (; p + 8 <= pixels; p += 8, src += 4) {
+        __m256i low = AverageSamplesAVX2(_mm256_loadu_si256(src), _mm256_loadu_si256(src + 1));
+        __m256i high = AverageSamplesAVX2(_mm256_loadu_si256(src + 2), _mm256_loadu_si256(src + 3));
+        __m256i packed = _mm256_permutevar8x32_epi32(_mm256_packus_epi16(low, high), order);
+        _mm256_storeu_si256((__m256i*)(out + p), packed);
+    }
+    Resolve4xSSE2(samples + p * 4, out + p, pixels - p);
+}
+
+// --- AVX-512 (F only; bilinear and resolve stay on AVX2, which needs no BW) ---
+
+KERNEL_AVX512 static inline uint64_t CoverageAVX512(const CoverageRow& row, const float* depth, int first, int count) {
+    const __m512 lanes = _mm512_setr_ps(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    const __m512 zero = _mm512_setzero_ps();
+    const __m512 e0 = _mm512_set1_ps(row.edge[0]), e1 = _mm512_set1_ps(row.edge[1]), e2 = _mm512_set1_ps(row.edge[2]);
+    const __m512 dx0 = _mm512_set1_ps(row.edgeDx[0]), dx1 = _mm512_set1_ps(row.edgeDx[1]), dx2 = _mm512_set1_ps(row.edgeDx[2]);
+    const __m512 z = _mm512_set1_ps(row.depth), dz = _mm512_set1_ps(row.depthDx);
+    uint64_t mask = 0;
+    for (int i = 0; i < count; i += 16) {
+        __mmask16 valid = count - i >= 16 ? (__mmask16)0xFFFF : (__mmask16)((1u << (count - i)) - 1);
+        __m512 x = _mm512_add_ps(_mm512_set1_ps((float)(row.offset + first + i)), lanes);
+        __mmask16 inside = _mm512_mask_cmp_ps_mask(valid, _mm512_add_ps(e0, _mm512_mul_ps(dx0, x)), zero, _CMP_GE_OQ);
+        inside = _mm512_mask_cmp_ps_mask(inside, _mm512_add_ps(e1, _mm512_mul_ps(dx1, x)), zero, _CMP_GE_OQ);
+        inside = _mm512_mask_cmp_ps_mask(inside, _mm512_add_ps(e2, _mm512_mul_ps(dx2, x)), zero, _CMP_GE_OQ);
+        inside = _mm512_mask_cmp_ps_mask(inside, _mm512_add_ps(z, _mm512_mul_ps(dz, x)),
+                                         _mm512_maskz_loadu_ps(valid, depth + first + i), _CMP_LT_OQ);
+        mask |= (uint64_t)inside << i;
+    }
+    return mask;
+}
+
+// Four points per register, one per 128-bit lane
+template <typename Points>
+KERNEL_AVX512 static inline void TransformPointsAVX512(Points points, const uint32_t* indices, int count, const Matrix4x4& m, Vector4S* out) {
+    const __m512 r0 = _mm512_setr4_ps(m.m[0][0], m.m[0][1], m.m[0][2], m.m[0][3]);
+    const __m512 r1 = _mm512_setr4_ps(m.m[1][0], m.m[1][1], m.m[1][2], m.m[1][3]);
+    const __m512 r2 = _mm512_setr4_ps(m.m[2][0], m.m[2][1], m.m[2][2], m.m[2][3]);
+    const __m512 r3 = _mm512_setr4_ps(m.m[3][0], m.m[3][1], m.m[3][2], m.m[3][3]);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const Vector3S a = PointAt(points, indices[i]);
+        const Vector3S b = PointAt(points, indices[i + 1]);
+        const Vector3S c = PointAt(points, indices[i + 2]);
+        const Vector3S d = PointAt(points, indices[i + 3]);
+        __m512 x = _mm512_setr_ps(a.x, a.x, a.x, a.x, b.x, b.x, b.x, b.x, c.x, c.x, c.x, c.x, d.x, d.x, d.x, d.x);
+        __m512 y = _mm512_setr_ps(a.y, a.y, a.y, a.y, b.y, b.y, b.y, b.y, c.y, c.y, c.y, c.y, d.y, d.y, d.y, d.y);
+        __m512 z = _mm512_setr_ps(a.z, a.z, a.z, a.z, b.z, b.z, b.z, b.z, c.z, c.z, c.z, c.z, d.z, d.z, d.z, d.z);
+        __m512 v = _mm512_add_ps(_mm512_mul_ps(x, r0), _mm512_mul_ps(y, r1));
+        v = _mm512_add_ps(_mm512_add_ps(v, _mm512_mul_ps(z, r2)), r3);
+        _mm512_storeu_ps(&out[i].x, v);
+    }
+    TransformPointsAVX2(points, indices + i, count - i, m, out + i);
+}
+
+template <typename T>
+KERNEL_AVX512 static inline void FillAVX512(T* dst, size_t count, T value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    const __m512i v = _mm512_set1_epi32((int)bits);
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) _mm512_storeu_si512(dst + i, v);
+    if (i < count) _mm512_mask_storeu_epi32(dst + i, (__mmask16)((1u << (count - i)) - 1), v);
+}
+#endif
+
+// --- Selection ---
+
+inline const char* CpuLevelName(CpuLevel level) {
+    switch (level) {
+        case CpuLevel::Scalar: return "Scalar";
+        case CpuLevel::SSE2: return "SSE2";
+        case CpuLevel::AVX2: return "AVX2";
+        case CpuLevel::AVX512: return "AVX-512";
+    }
+    return "Unknown";
+}
+
+// Highest level both this build and the running CPU support
+inline CpuLevel DetectCpuLevel() {
+#if defined(CPU_DISPATCH_X86)
+    // cpuid, plus xgetbv to check the OS saves the wider registers
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) return CpuLevel::AVX512;
+    if (__builtin_cpu_supports("avx2")) return CpuLevel::AVX2;
+#endif
+#if defined(__SSE2__)
+    return CpuLevel::SSE2;
+#else
+    return CpuLevel::Scalar;
+#endif
+}
+
+inline bool ParseCpuLevel(const char* name, CpuLevel& level) {
+    static const char* const names[] = {"scalar", "sse2", "avx2", "avx512"};
+    for (int i = 0; i < 4; i++) {
+        if (strcmp(name, names[i]) == 0) {
+            level = (CpuLevel)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+// The detected level, capped by RENDERER_CPU=scalar|sse2|avx2|avx512 when that is set
+inline CpuLevel SelectCpuLevel() {
+    CpuLevel level = DetectCpuLevel();
+    const char* forced = getenv(kCpuLevelEnvironment);
+    if (!forced || !*forced) return level;
+    CpuLevel requested;
+    if (!ParseCpuLevel(forced, requested)) {
+        fprintf(stderr, "%s: unknown level '%s', using %s\n", kCpuLevelEnvironment, forced, CpuLevelName(level));
+        return level;
+    }
+    if (requested > level) {
+        fprintf(stderr, "%s: %s not supported here, using %s\n", kCpuLevelEnvironment, CpuLevelName(requested), CpuLevelName(level));
+        return level;
+    }
+    return requested;
+}
+
+// Kernels for level, or for the highest supported level below it
+inline const CpuKernels& GetCpuKernels(CpuLevel level) {
+    static const CpuKernels scalar = {
+        CpuLevel::Scalar, CoverageScalar, BilinearFilter,
+        TransformPointsScalar<const Vertex*>, TransformPointsScalar<const uint16_t*>,
+        FillScalar<Color>, FillScalar<float>, Resolve4xScalar
+    };
+    level = std::min(level, DetectCpuLevel());
+#if defined(CPU_DISPATCH_X86)
+    static const CpuKernels avx512 = {
+        CpuLevel::AVX512, CoverageAVX512, BilinearFilterAVX2,
+        TransformPointsAVX512<const Vertex*>, TransformPointsAVX512<const uint16_t*>,
+        FillAVX512<Color>, FillAVX512<float>, Resolve4xAVX2
+    };
+    static const CpuKernels avx2 = {
+        CpuLevel::AVX2, CoverageAVX2, BilinearFilterAVX2,
+        TransformPointsAVX2<const Vertex*>, TransformPointsAVX2<const uint16_t*>,
+        FillAVX2<Color>, FillAVX2<float>, Resolve4xAVX2
+    };
+    if (level == CpuLevel::AVX512) return avx512;
+    if (level == CpuLevel::AVX2) return avx2;
+#endif
+#if defined(__SSE2__)
+    static const CpuKernels sse2 = {
+        CpuLevel::SSE2, CoverageSSE2, BilinearFilterSSE2,
+        TransformPointsSSE2<const Vertex*>, TransformPointsSSE2<const uint16_t*>,
+        FillSSE2<Color>, FillSSE2<float>, Resolve4xSSE2
+    };
+    if (level == CpuLevel::SSE2) return sse2;
+#endif
+    return scalar;
+}
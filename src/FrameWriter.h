@@ -0,0 +1,238 @@
+#pragma once
+#include "raylib.h"
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <cctype>
+#include <iostream>
+
+enum class FrameFormat {
+    RawRGBA,    // Back-to-back RGBA8 frames, e.g. for ffmpeg -f rawvideo -pix_fmt rgba
+    PPM,        // One binary PPM per frame; the path is a printf pattern such as "out/frame_%05d.ppm"
+    Y4M         // YUV4MPEG2 stream, 4:2:0 full range
+};
+
+// Streams frames to a file, pipe ("-" for stdout) or PPM sequence. Encoding and
+// writing happen on a background thread fed by a bounded queue, so the render
+// loop only pays for one frame copy unless the writer falls a whole queue behind.
+class FrameWriter {
+public:
+    FrameWriter(const std::string& path, FrameFormat format, int width, int height, int fps, size_t queueCapacity = 8)
+        : path(path), format(format), width(width), height(height), fps(fps), capacity(queueCapacity) {}
+
+    ~FrameWriter() {
+        Close();
+    }
+
+    // A PPM path holds exactly one frame number conversion, %d or %0Nd, with any other %
+    // written as %%: it is passed to snprintf as the format
+    static bool IsValidPPMPattern(const std::string& pattern) {
+        int conversions = 0;
+        for (size_t i = 0; i < pattern.size(); i++) {
+            if (pattern[i] != '%') continue;
+            if (++i < pattern.size() && pattern[i] == '%') continue;
+            if (i < pattern.size() && pattern[i] == '0') {
+                size_t digits = ++i;
+                while (i < pattern.size() && isdigit((unsigned char)pattern[i])) i++;
+                if (i == digits) return false;
+            }
+            if (i == pattern.size() || pattern[i] != 'd') return false;
+            conversions++;
+        }
+        return conversions == 1;
+    }
+
+    bool Open() {
+        if (format == FrameFormat::PPM && !IsValidPPMPattern(path)) {
+            std::cerr << "PPM output needs a frame number pattern such as out/frame_%05d.ppm: " << path << std::endl;
+            return false;
+        }
+        if (format != FrameFormat::PPM) {
+            if (path == "-") {
+                file = stdout;
+            } else {
+                file = fopen(path.c_str(), "wb");
+            }
+            if (!file) {
+                std::cerr << "Failed to open frame output: " << path << std::endl;
+                return false;
+            }
+            if (format == FrameFormat::Y4M) {
+                fprintf(file, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", width, height, fps);
+            }
+        }
+
+        running = true;
+        writerThread = std::thread([this] { WriterLoop(); });
+        return true;
+    }
+
+    // Copies the frame into a recycled buffer and queues it; blocks only while the queue is full
+    void Submit(const Color* pixels) {
+        std::vector<Color> frame;
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            spaceCondition.wait(lock, [this] { return queue.size() < capacity || failed; });
+            if (failed) return;
+            if (!freeFrames.empty()) {
+                frame = std::move(freeFrames.back());
+                freeFrames.pop_back();
+            }
+        }
+
+        frame.resize((size_t)width * height);
+        memcpy(frame.data(), pixels, frame.size() * sizeof(Color));
+
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            queue.push_back(std::move(frame));
+        }
+        frameCondition.notify_one();
+    }
+
+    // Drains the queue and closes the output
+    void Close() {
+        if (!writerThread.joinable()) return;
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            running = false;
+        }
+        frameCondition.notify_all();
+        writerThread.join();
+
+        if (file && file != stdout) {
+            fclose(file);
+        } else if (file) {
+            fflush(file);
+        }
+        file = nullptr;
+    }
+
+    int GetFramesWritten() const { return framesWritten; }
+    bool HasFailed() const { return failed; }
+
+private:
+    void WriterLoop() {
+        while (true) {
+            std::vector<Color> frame;
+            {
+                std::unique_lock<std::mutex> lock(queueMutex);
+                frameCondition.wait(lock, [this] { return !running || !queue.empty(); });
+                if (queue.empty()) return;
+                frame = std::move(queue.front());
+                queue.pop_front();
+            }
+            spaceCondition.notify_one();
+
+            if (!WriteFrame(frame)) {
+                std::unique_lock<std::mutex> lock(queueMutex);
+                failed = true;
+                queue.clear();
+                spaceCondition.notify_all();
+                return;
+            }
+            framesWritten++;
+
+            std::unique_lock<std::mutex> lock(queueMutex);
+            freeFrames.push_back(std::move(frame));
+        }
+    }
+
+    bool WriteFrame(const std::vector<Color>& frame) {
+        switch (format) {
+            case FrameFormat::RawRGBA:
+                return fwrite(frame.data(), sizeof(Color), frame.size(), file) == frame.size();
+            case FrameFormat::PPM:
+                return WritePPM(frame);
+            case FrameFormat::Y4M:
+            default:
+                return WriteY4M(frame);
+        }
+    }
+
+    bool WritePPM(const std::vector<Color>& frame) {
+        char name[1024];
+        snprintf(name, sizeof(name), path.c_str(), framesWritten.load());
+        FILE* out = fopen(name, "wb");
+        if (!out) {
+            std::cerr << "Failed to open frame output: " << name << std::endl;
+            return false;
+        }
+
+        scratch.resize((size_t)width * height * 3);
+        for (size_t i = 0; i < frame.size(); i++) {
+            scratch[i * 3 + 0] = frame[i].r;
+            scratch[i * 3 + 1] = frame[i].g;
+            scratch[i * 3 + 2] = frame[i].b;
+        }
+        fprintf(out, "P6\n%d %d\n255\n", width, height);
+        bool ok = fwrite(scratch.data(), 1, scratch.size(), out) == scratch.size();
+        fclose(out);
+        return ok;
+    }
+
+    // BT.601 full-range RGB to YCbCr, chroma averaged over 2x2 blocks
+    bool WriteY4M(const std::vector<Color>& frame) {
+        int chromaW = (width + 1) / 2;
+        int chromaH = (height + 1) / 2;
+        size_t lumaSize = (size_t)width * height;
+        size_t chromaSize = (size_t)chromaW * chromaH;
+        scratch.resize(lumaSize + chromaSize * 2);
+        unsigned char* planeY = scratch.data();
+        unsigned char* planeU = planeY + lumaSize;
+        unsigned char* planeV = planeU + chromaSize;
+
+        for (size_t i = 0; i < lumaSize; i++) {
+            const Color& c = frame[i];
+            planeY[i] = (unsigned char)((77 * c.r + 150 * c.g + 29 * c.b + 128) >> 8);
+        }
+
+        for (int cy = 0; cy < chromaH; cy++) {
+            for (int cx = 0; cx < chromaW; cx++) {
+                int r = 0, g = 0, b = 0, n = 0;
+                for (int dy = 0; dy < 2; dy++) {
+                    int y = std::min(cy * 2 + dy, height - 1);
+                    for (int dx = 0; dx < 2; dx++) {
+                        int x = std::min(cx * 2 + dx, width - 1);
+                        const Color& c = frame[(size_t)y * width + x];
+                        r += c.r; g += c.g; b += c.b; n++;
+                    }
+                }
+                r /= n; g /= n; b /= n;
+                int u = ((-43 * r - 85 * g + 128 * b + 128) >> 8) + 128;
+                int v = ((128 * r - 107 * g - 21 * b + 128) >> 8) + 128;
+                planeU[cy * chromaW + cx] = (unsigned char)std::max(0, std::min(255, u));
+                planeV[cy * chromaW + cx] = (unsigned char)std::max(0, std::min(255, v));
+            }
+        }
+
+        if (fputs("FRAME\n", file) < 0) return false;
+        return fwrite(scratch.data(), 1, scratch.size(), file) == scratch.size();
+    }
+
+    std::string path;
+    FrameFormat format;
+    int width, height;
+    int fps;
+    size_t capacity;
+    FILE* file = nullptr;
+
+    std::thread writerThread;
+    std::mutex queueMutex;
+    std::condition_variable frameCondition;
+    std::condition_variable spaceCondition;
+    std::deque<std::vector<Color>> queue;
+    std::vector<std::vector<Color>> freeFrames;
+    std::vector<unsigned char> scratch;   // Only touched by the writer thread
+
+    bool running = false;
+    std::atomic<bool> failed{false};
+    std::atomic<int> framesWritten{0};
+};
@@ -1,12 +1,17 @@
 #pragma once
 #include "Components.h"
-#include "Texture.h"
+#include "AssetManager.h"
+#include "TransformSystem.h"
 
 class GameObject {
 public: 
-    MeshS mesh;
-    TransformS transform;
-    TextureS* texture = nullptr;
+    MeshHandle mesh;
+    TransformHandle transform;
+    TextureHandle texture;   // Null handle for an untextured object
+    float opacity = 1.0f;    // Below 1 the object is alpha-blended, in any draw order
+    // Pose of a skinned mesh: each joint's transform in object space, bind pose if empty
+    std::vector<Matrix4x4> jointTransforms;
+    std::vector<float> morphWeights;   // Per morph target of the mesh; missing ones are 0
 
-    GameObject(MeshS m) : mesh(m) {}
-};
\ No newline at end of file
+    GameObject(TransformSystem& transforms, MeshHandle m) : mesh(m), transform(transforms) {}
+};
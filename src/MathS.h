@@ -1,6 +1,10 @@
 #pragma once
 #include <cmath>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 struct Vector3S {
     float x, y, z;
 };
@@ -91,12 +95,25 @@ inline Vector3S MultiplyVectorDirection(const Vector3S& i, const Matrix4x4& m) {
     return v;
 }
 
+// Each output row is a combination of m2's rows, summed in the same order as the
+// scalar loop, so both paths give identical results
 inline Matrix4x4 MultiplyMatrix(const Matrix4x4& m1, const Matrix4x4& m2) {
-    Matrix4x4 out = {0};
-    for (int c = 0; c < 4; c++)
-        for (int r = 0; r < 4; r++)
-            for (int j = 0; j < 4; j++)
-                out.m[r][c] += m1.m[r][j] * m2.m[j][c];
+    Matrix4x4 out;
+#if defined(__SSE2__)
+    __m128 rows[4];
+    for (int j = 0; j < 4; j++) rows[j] = _mm_loadu_ps(m2.m[j]);
+    for (int r = 0; r < 4; r++) {
+        __m128 sum = _mm_mul_ps(_mm_set1_ps(m1.m[r][0]), rows[0]);
+        sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(m1.m[r][1]), rows[1]));
+        sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(m1.m[r][2]), rows[2]));
+        sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(m1.m[r][3]), rows[3]));
+        _mm_storeu_ps(out.m[r], sum);
+    }
+#else
+    for (int r = 0; r < 4; r++)
+        for (int c = 0; c < 4; c++)
+            out.m[r][c] = m1.m[r][0] * m2.m[0][c] + m1.m[r][1] * m2.m[1][c] + m1.m[r][2] * m2.m[2][c] + m1.m[r][3] * m2.m[3][c];
+#endif
     return out;
 }
 
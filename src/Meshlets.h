@@ -0,0 +1,219 @@
+#pragma once
+#include "Components.h"
+#include "MathS.h"
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+
+static const int kMeshletMaxVertices = 64;
+static const int kMeshletMaxTriangles = 124;
+// Normals spread wider than this never all face away at once; such meshlets get no cone
+static const float kMeshletMinConeDot = 0.1f;
+// A triangle joins a meshlet only if it faces within acos of this of the meshlet's average
+static const float kMeshletGrowDot = 0.5f;
+
+// Position of a corner as an exact key: corners split by a normal or uv seam still
+// make their triangles neighbours
+struct MeshletPositionKey {
+    uint32_t x, y, z;
+    bool operator==(const MeshletPositionKey& other) const { return x == other.x && y == other.y && z == other.z; }
+};
+
+struct MeshletPositionHash {
+    size_t operator()(const MeshletPositionKey& key) const {
+        return (size_t)key.x * 73856093u ^ (size_t)key.y * 19349663u ^ (size_t)key.z * 83492791u;
+    }
+};
+
+inline void UpdateMeshletBounds(MeshS& mesh);
+
+// Grows each meshlet from a seed triangle over its neighbours, taking the one needing the
+// fewest new vertices and, among those, the one facing most like the meshlet so far.
+// Neighbours facing too far away are left for another meshlet, which keeps the normal
+// cones narrow enough to cull with. Rewrites the indices so every meshlet's triangles
+// are consecutive.
+inline void BuildMeshlets(MeshS& mesh) {
+    mesh.meshlets.clear();
+    mesh.meshletVertices.clear();
+    mesh.meshletTriangles.clear();
+    int triangleCount = (int)(mesh.indices.size() / 3);
+
+    // Triangles around each distinct corner position, as offsets into one array
+    std::unordered_map<MeshletPositionKey, int, MeshletPositionHash> positionIds;
+    std::vector<int> cornerPositions(triangleCount * 3);
+    for (int c = 0; c < triangleCount * 3; c++) {
+        const Vector3S& p = mesh.vertices[mesh.indices[c]].position;
+        MeshletPositionKey key;
+        memcpy(&key.x, &p.x, 4);
+        memcpy(&key.y, &p.y, 4);
+        memcpy(&key.z, &p.z, 4);
+        cornerPositions[c] = positionIds.emplace(key, (int)positionIds.size()).first->second;
+    }
+    std::vector<int> adjacencyStart(positionIds.size() + 1, 0);
+    for (int position : cornerPositions) adjacencyStart[position + 1]++;
+    for (size_t i = 1; i < adjacencyStart.size(); i++) adjacencyStart[i] += adjacencyStart[i - 1];
+    std::vector<int> adjacency(cornerPositions.size());
+    std::vector<int> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+    for (int c = 0; c < triangleCount * 3; c++) {
+        adjacency[fill[cornerPositions[c]]++] = c / 3;
+    }
+
+    std::vector<Vector3S> faceNormals(triangleCount);
+    for (int t = 0; t < triangleCount; t++) {
+        const Vector3S& p0 = mesh.vertices[mesh.indices[t * 3]].position;
+        const Vector3S& p1 = mesh.vertices[mesh.indices[t * 3 + 1]].position;
+        const Vector3S& p2 = mesh.vertices[mesh.indices[t * 3 + 2]].position;
+        Vector3S n = Vector3Cross(Vector3Sub(p1, p0), Vector3Sub(p2, p0));
+        float length = Vector3Length(n);
+        faceNormals[t] = length < 1e-12f ? Vector3S{0, 0, 0} : Vector3Scale(n, 1.0f / length);
+    }
+
+    std::vector<char> assigned(triangleCount, 0);
+    std::vector<int> order;
+    order.reserve(triangleCount);
+    std::vector<int> localIndex(mesh.vertices.size(), -1);
+    std::vector<int> candidates;
+    int nextSeed = 0;
+
+    auto newVertices = [&](int t) {
+        int count = 0;
+        for (int k = 0; k < 3; k++) {
+            int index = mesh.indices[t * 3 + k];
+            bool repeated = (k > 0 && index == mesh.indices[t * 3]) || (k > 1 && index == mesh.indices[t * 3 + 1]);
+            if (localIndex[index] < 0 && !repeated) count++;
+        }
+        return count;
+    };
+
+    while ((int)order.size() < triangleCount) {
+        while (assigned[nextSeed]) nextSeed++;
+        Meshlet current = {};
+        current.vertexOffset = (uint32_t)mesh.meshletVertices.size();
+        current.triangleOffset = (uint32_t)mesh.meshletTriangles.size();
+        Vector3S normalSum = {0, 0, 0};
+        candidates.clear();
+
+        int next = nextSeed;
+        while (next >= 0) {
+            assigned[next] = 1;
+            order.push_back(next);
+            for (int k = 0; k < 3; k++) {
+                int index = mesh.indices[next * 3 + k];
+                if (localIndex[index] < 0) {
+                    localIndex[index] = current.vertexCount++;
+                    mesh.meshletVertices.push_back((uint32_t)index);
+                }
+                mesh.meshletTriangles.push_back((uint8_t)localIndex[index]);
+                int position = cornerPositions[next * 3 + k];
+                for (int a = adjacencyStart[position]; a < adjacencyStart[position + 1]; a++) {
+                    if (!assigned[adjacency[a]]) candidates.push_back(adjacency[a]);
+                }
+            }
+            current.triangleCount++;
+            normalSum = Vector3Add(normalSum, faceNormals[next]);
+            if (current.triangleCount == kMeshletMaxTriangles) break;
+
+            Vector3S axis = Vector3Length(normalSum) > 1e-6f ? Vector3Normalize(normalSum) : Vector3S{0, 0, 0};
+            next = -1;
+            int bestNew = 4;
+            float bestDot = -2.0f;
+            for (size_t c = 0; c < candidates.size();) {
+                int t = candidates[c];
+                if (assigned[t]) {
+                    candidates[c] = candidates.back();
+                    candidates.pop_back();
+                    continue;
+                }
+                c++;
+                float dot = Vector3Dot(faceNormals[t], axis);
+                bool degenerate = faceNormals[t].x == 0.0f && faceNormals[t].y == 0.0f && faceNormals[t].z == 0.0f;
+                if (!degenerate && dot < kMeshletGrowDot) continue;
+                int added = newVertices(t);
+                if (current.vertexCount + added > kMeshletMaxVertices) continue;
+                if (added < bestNew || (added == bestNew && dot > bestDot)) {
+                    next = t;
+                    bestNew = added;
+                    bestDot = dot;
+                }
+            }
+        }
+
+        for (uint32_t v = 0; v < current.vertexCount; v++) {
+            localIndex[mesh.meshletVertices[current.vertexOffset + v]] = -1;
+        }
+        mesh.meshlets.push_back(current);
+    }
+
+    std::vector<int> indices(mesh.indices.size());
+    for (int t = 0; t < triangleCount; t++) {
+        std::copy(&mesh.indices[order[t] * 3], &mesh.indices[order[t] * 3] + 3, &indices[t * 3]);
+    }
+    std::copy(indices.begin(), indices.end(), mesh.indices.begin());
+
+    UpdateMeshletBounds(mesh);
+}
+
+// Refits every meshlet's sphere and normal cone to the mesh's current vertex positions
+inline void UpdateMeshletBounds(MeshS& mesh) {
+    for (Meshlet& meshlet : mesh.meshlets) {
+        auto position = [&](uint32_t local) -> const Vector3S& {
+            return mesh.vertices[mesh.meshletVertices[meshlet.vertexOffset + local]].position;
+        };
+        auto corner = [&](int triangle, int k) -> const Vector3S& {
+            return position(mesh.meshletTriangles[meshlet.triangleOffset + triangle * 3 + k]);
+        };
+
+        // Sphere around the bounding box centre
+        Vector3S minP = position(0), maxP = position(0);
+        for (uint32_t v = 1; v < meshlet.vertexCount; v++) {
+            const Vector3S& p = position(v);
+            minP = {std::min(minP.x, p.x), std::min(minP.y, p.y), std::min(minP.z, p.z)};
+            maxP = {std::max(maxP.x, p.x), std::max(maxP.y, p.y), std::max(maxP.z, p.z)};
+        }
+        meshlet.center = Vector3Scale(Vector3Add(minP, maxP), 0.5f);
+        meshlet.radius = 0.0f;
+        for (uint32_t v = 0; v < meshlet.vertexCount; v++) {
+            meshlet.radius = std::max(meshlet.radius, Vector3Length(Vector3Sub(position(v), meshlet.center)));
+        }
+
+        // Cone of the true face normals. Degenerate triangles are left out: the renderer's
+        // face test culls them wherever the camera is.
+        std::vector<Vector3S> normals;
+        std::vector<int> faces;
+        Vector3S sum = {0, 0, 0};
+        for (int t = 0; t < meshlet.triangleCount; t++) {
+            Vector3S n = Vector3Cross(Vector3Sub(corner(t, 1), corner(t, 0)), Vector3Sub(corner(t, 2), corner(t, 0)));
+            float length = Vector3Length(n);
+            if (length < 1e-12f) continue;
+            n = Vector3Scale(n, 1.0f / length);
+            normals.push_back(n);
+            faces.push_back(t);
+            sum = Vector3Add(sum, n);
+        }
+        meshlet.coneApex = meshlet.center;
+        meshlet.coneAxis = {0, 0, 1};
+        meshlet.coneCutoff = 2.0f;
+        float sumLength = Vector3Length(sum);
+        if (normals.empty() || sumLength < 1e-6f) continue;
+
+        Vector3S axis = Vector3Scale(sum, 1.0f / sumLength);
+        float minDot = 1.0f;
+        for (const Vector3S& n : normals) {
+            minDot = std::min(minDot, Vector3Dot(n, axis));
+        }
+        if (minDot <= kMeshletMinConeDot) continue;
+
+        // Slide the apex back along the axis until it is behind every triangle's plane
+        float maxT = 0.0f;
+        for (size_t f = 0; f < normals.size(); f++) {
+            float t = Vector3Dot(Vector3Sub(meshlet.center, corner(faces[f], 0)), normals[f]) / Vector3Dot(axis, normals[f]);
+            maxT = std::max(maxT, t);
+        }
+        meshlet.coneApex = Vector3Sub(meshlet.center, Vector3Scale(axis, maxT));
+        meshlet.coneAxis = axis;
+        meshlet.coneCutoff = sqrtf(1.0f - minDot * minDot);
+    }
+}
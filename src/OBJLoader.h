@@ -4,6 +4,8 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <map>
+#include <tuple>
 
 class ObjLoader {
 public:
@@ -83,10 +85,27 @@ public:
         outMesh.vertices.clear();
         outMesh.indices.clear();
 
+        // Corners naming the same position, uv and normal share one vertex. Corners with a
+        // computed face normal are never shared.
+        std::map<std::tuple<int, int, int>, int> cornerVertices;
+        std::vector<int> faceIndices;
+
         for (const auto& face : faces) {
-            int baseIndex = static_cast<int>(outMesh.vertices.size());
+            faceIndices.clear();
 
             for (size_t i = 0; i < face.size(); i++) {
+                bool hasNormal = face[i].normalIndex >= 0 && face[i].normalIndex < static_cast<int>(normals.size());
+                std::tuple<int, int, int> key(face[i].posIndex, face[i].uvIndex, face[i].normalIndex);
+                if (hasNormal) {
+                    auto found = cornerVertices.find(key);
+                    if (found != cornerVertices.end()) {
+                        faceIndices.push_back(found->second);
+                        continue;
+                    }
+                    cornerVertices[key] = static_cast<int>(outMesh.vertices.size());
+                }
+                faceIndices.push_back(static_cast<int>(outMesh.vertices.size()));
+
                 Vertex v;
                 v.position = positions[face[i].posIndex];
 
@@ -96,7 +115,7 @@ public:
                     v.uv = {0, 0};
                 }
 
-                if (face[i].normalIndex >= 0 && face[i].normalIndex < static_cast<int>(normals.size())) {
+                if (hasNormal) {
                     v.normal = normals[face[i].normalIndex];
                 } else {
                     Vector3S p0 = positions[face[0].posIndex];
@@ -111,9 +130,9 @@ public:
             }
 
             for (size_t i = 1; i < face.size() - 1; i++) {
-                outMesh.indices.push_back(baseIndex);
-                outMesh.indices.push_back(baseIndex + static_cast<int>(i));
-                outMesh.indices.push_back(baseIndex + static_cast<int>(i + 1));
+                outMesh.indices.push_back(faceIndices[0]);
+                outMesh.indices.push_back(faceIndices[i]);
+                outMesh.indices.push_back(faceIndices[i + 1]);
             }
         }
 
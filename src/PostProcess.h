@@ -0,0 +1,301 @@
+#pragma once
+#include "raylib.h"
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <vector>
+
+enum class PostEffectType {
+    ToneMap,    // Filmic curve on exposure * colour, normalized so white stays white
+    Gamma,      // colour^(1/gamma)
+    Fog,        // Blends toward a colour with view distance; empty pixels get all of it
+    Vignette,   // Darkens toward the corners
+    FXAA,       // Edge antialiasing from the 3x3 neighbourhood; needs a 2-pixel halo
+    ColorGrade  // 3D lookup table, mixed with the input by an amount
+};
+
+static const int kPostCurveSize = 1024;      // Segments of the ToneMap/Gamma response tables
+static const int kFXAAHalo = 2;              // Pixels FXAA reads beyond the pixel it writes
+
+// Colour grading table: size^3 entries, red fastest, each the output for its grid colour
+struct ColorLUT {
+    int size = 0;
+    std::vector<Color> texels;
+
+    static std::shared_ptr<ColorLUT> MakeIdentity(int size) {
+        auto lut = std::make_shared<ColorLUT>();
+        lut->size = size;
+        lut->texels.resize((size_t)size * size * size);
+        for (int b = 0; b < size; b++) {
+            for (int g = 0; g < size; g++) {
+                for (int r = 0; r < size; r++) {
+                    lut->texels[((size_t)b * size + g) * size + r] = {
+                        (unsigned char)(255 * r / (size - 1)), (unsigned char)(255 * g / (size - 1)),
+                        (unsigned char)(255 * b / (size - 1)), 255};
+                }
+            }
+        }
+        return lut;
+    }
+};
+
+struct PostEffect {
+    PostEffectType type;
+    float params[2];             // ToneMap: exposure. Fog: density, start. Vignette: strength, radius.
+                                 // ColorGrade: amount.
+    Color color;                 // Fog colour
+    std::shared_ptr<const std::vector<float>> curve;   // ToneMap and Gamma: kPostCurveSize + 1 samples
+    std::shared_ptr<const ColorLUT> lut;
+};
+
+// Post effects in the order they apply, built with the chained adders. Each tile's raster
+// job runs the whole chain on the tile while its colour and depth are still in cache;
+// consecutive per-pixel effects share one sweep over the tile.
+class PostChain {
+public:
+    PostChain& ToneMap(float exposure) {
+        float white = Filmic(exposure);
+        return AddCurve(PostEffectType::ToneMap, exposure, [=](float c) { return Filmic(exposure * c) / white; });
+    }
+    PostChain& Gamma(float gamma) {
+        return AddCurve(PostEffectType::Gamma, gamma, [=](float c) { return powf(c, 1.0f / gamma); });
+    }
+    // Distance fog: the blend is 1 - exp(-density * (distance - start)) past start
+    PostChain& Fog(Color color, float density, float start = 0.0f) {
+        PostEffect effect = {PostEffectType::Fog, {density, start}, color, nullptr, nullptr};
+        effects.push_back(effect);
+        return *this;
+    }
+    // radius is where darkening starts, as a fraction of the centre-to-corner distance
+    PostChain& Vignette(float strength, float radius = 0.5f) {
+        PostEffect effect = {PostEffectType::Vignette, {strength, radius}, BLACK, nullptr, nullptr};
+        effects.push_back(effect);
+        return *this;
+    }
+    PostChain& FXAA() {
+        PostEffect effect = {PostEffectType::FXAA, {0.0f, 0.0f}, BLACK, nullptr, nullptr};
+        effects.push_back(effect);
+        return *this;
+    }
+    PostChain& ColorGrade(std::shared_ptr<const ColorLUT> lut, float amount = 1.0f) {
+        if (!lut || lut->size < 2) return *this;
+        PostEffect effect = {PostEffectType::ColorGrade, {amount, 0.0f}, BLACK, nullptr, std::move(lut)};
+        effects.push_back(effect);
+        return *this;
+    }
+
+    bool IsEmpty() const { return effects.empty(); }
+    const std::vector<PostEffect>& GetEffects() const { return effects; }
+
+    // Pixels beyond a tile that must be rendered with it for the tile's output to be exact
+    int GetHalo() const {
+        int halo = 0;
+        for (const PostEffect& effect : effects) {
+            if (effect.type == PostEffectType::FXAA) halo += kFXAAHalo;
+        }
+        return halo;
+    }
+
+    bool UsesDepth() const {
+        for (const PostEffect& effect : effects) {
+            if (effect.type == PostEffectType::Fog) return true;
+        }
+        return false;
+    }
+
+private:
+    static float Filmic(float x) {
+        // Narkowicz's fit of the ACES reference curve
+        return (x * (2.51f * x + 0.03f)) / (x * (2.43f * x + 0.59f) + 0.14f);
+    }
+
+    template <typename Fn>
+    PostChain& AddCurve(PostEffectType type, float param, Fn fn) {
+        auto curve = std::make_shared<std::vector<float>>(kPostCurveSize + 1);
+        for (int i = 0; i <= kPostCurveSize; i++) {
+            (*curve)[i] = std::max(0.0f, std::min(1.0f, fn((float)i / kPostCurveSize)));
+        }
+        PostEffect effect = {type, {param, 0.0f}, BLACK, std::move(curve), nullptr};
+        effects.push_back(effect);
+        return *this;
+    }
+
+    std::vector<PostEffect> effects;
+};
+
+// A tile's resolved pixels and its halo, as floats in [0, 1], for the chain to work on
+struct PostTile {
+    int startX, startY;          // Frame position of the first pixel
+    int width, height;           // Halo included
+    float* rgb;                  // width * height * 3
+    const float* viewDepth;      // Per pixel, +infinity where nothing was drawn; null without fog
+    int frameWidth, frameHeight;
+};
+
+static inline float PostLuma(const float* rgb) {
+    return rgb[0] * 0.299f + rgb[1] * 0.587f + rgb[2] * 0.114f;
+}
+
+static inline float SampleCurve(const std::vector<float>& curve, float c) {
+    float x = std::max(0.0f, std::min(1.0f, c)) * kPostCurveSize;
+    int i = std::min((int)x, kPostCurveSize - 1);
+    float t = x - i;
+    return curve[i] + (curve[i + 1] - curve[i]) * t;
+}
+
+static inline void SampleLUT(const ColorLUT& lut, const float* in, float* out) {
+    float scale = (float)(lut.size - 1);
+    int base[3];
+    float t[3];
+    for (int k = 0; k < 3; k++) {
+        float x = std::max(0.0f, std::min(1.0f, in[k])) * scale;
+        base[k] = std::min((int)x, lut.size - 2);
+        t[k] = x - base[k];
+    }
+    out[0] = out[1] = out[2] = 0.0f;
+    for (int corner = 0; corner < 8; corner++) {
+        int dr = corner & 1, dg = (corner >> 1) & 1, db = corner >> 2;
+        float w = (dr ? t[0] : 1.0f - t[0]) * (dg ? t[1] : 1.0f - t[1]) * (db ? t[2] : 1.0f - t[2]);
+        const Color& c = lut.texels[((size_t)(base[2] + db) * lut.size + base[1] + dg) * lut.size + base[0] + dr];
+        out[0] += w * c.r;
+        out[1] += w * c.g;
+        out[2] += w * c.b;
+    }
+    for (int k = 0; k < 3; k++) out[k] *= 1.0f / 255.0f;
+}
+
+static inline void ApplyPixelEffect(const PostEffect& effect, const PostTile& tile, int pixel, float* rgb) {
+    switch (effect.type) {
+        case PostEffectType::ToneMap:
+        case PostEffectType::Gamma:
+            for (int k = 0; k < 3; k++) rgb[k] = SampleCurve(*effect.curve, rgb[k]);
+            break;
+
+        case PostEffectType::Fog: {
+            float distance = tile.viewDepth[pixel] - effect.params[1];
+            if (distance <= 0.0f) break;
+            float amount = 1.0f - expf(-effect.params[0] * distance);
+            const float fog[3] = {effect.color.r / 255.0f, effect.color.g / 255.0f, effect.color.b / 255.0f};
+            for (int k = 0; k < 3; k++) rgb[k] += (fog[k] - rgb[k]) * amount;
+            break;
+        }
+
+        case PostEffectType::Vignette: {
+            int x = tile.startX + pixel % tile.width;
+            int y = tile.startY + pixel / tile.width;
+            float dx = ((x + 0.5f) / tile.frameWidth - 0.5f) * 2.0f;
+            float dy = ((y + 0.5f) / tile.frameHeight - 0.5f) * 2.0f;
+            float r = sqrtf((dx * dx + dy * dy) * 0.5f);
+            float t = std::max(0.0f, std::min(1.0f, (r - effect.params[1]) / std::max(1e-4f, 1.0f - effect.params[1])));
+            float darken = 1.0f - effect.params[0] * t * t * (3.0f - 2.0f * t);
+            for (int k = 0; k < 3; k++) rgb[k] *= darken;
+            break;
+        }
+
+        case PostEffectType::ColorGrade: {
+            float graded[3];
+            SampleLUT(*effect.lut, rgb, graded);
+            for (int k = 0; k < 3; k++) rgb[k] += (graded[k] - rgb[k]) * effect.params[0];
+            break;
+        }
+
+        default:
+            break;
+    }
+}
+
+// Bilinear fetch at (dx, dy) from pixel (x, y) of the tile, clamped to its edges. The
+// offset is never added to the pixel's coordinate as a float, where its rounding would
+// depend on where the tile starts.
+static inline void SampleTile(const PostTile& tile, const float* rgb, int x, int y, float dx, float dy, float* out) {
+    float floorX = floorf(dx), floorY = floorf(dy);
+    float tx = dx - floorX, ty = dy - floorY;
+    int x0 = std::max(0, std::min(tile.width - 1, x + (int)floorX));
+    int y0 = std::max(0, std::min(tile.height - 1, y + (int)floorY));
+    int x1 = std::max(0, std::min(tile.width - 1, x + (int)floorX + 1));
+    int y1 = std::max(0, std::min(tile.height - 1, y + (int)floorY + 1));
+    const float* p00 = rgb + (y0 * tile.width + x0) * 3;
+    const float* p10 = rgb + (y0 * tile.width + x1) * 3;
+    const float* p01 = rgb + (y1 * tile.width + x0) * 3;
+    const float* p11 = rgb + (y1 * tile.width + x1) * 3;
+    for (int k = 0; k < 3; k++) {
+        float top = p00[k] + (p10[k] - p00[k]) * tx;
+        float bottom = p01[k] + (p11[k] - p01[k]) * tx;
+        out[k] = top + (bottom - top) * ty;
+    }
+}
+
+// FXAA in its compact form: the luma gradient of the diagonal neighbours gives the edge
+// direction, and the pixel is replaced by a blend of taps along it, up to a pixel away.
+// Low-contrast pixels are left alone. Reads source, writes tile.rgb.
+static inline void ApplyFXAA(const PostTile& tile, const float* source) {
+    const float reduceMin = 1.0f / 128.0f;
+    const float reduceMul = 1.0f / 8.0f;
+    const float spanMax = 2.0f;             // Taps stay within kFXAAHalo of the pixel
+    const float edgeThreshold = 1.0f / 8.0f;
+    const float edgeThresholdMin = 1.0f / 24.0f;
+
+    auto lumaAt = [&](int x, int y) {
+        x = std::max(0, std::min(tile.width - 1, x));
+        y = std::max(0, std::min(tile.height - 1, y));
+        return PostLuma(source + (y * tile.width + x) * 3);
+    };
+
+    for (int y = 0; y < tile.height; y++) {
+        for (int x = 0; x < tile.width; x++) {
+            float lumaM = lumaAt(x, y);
+            float lumaNW = lumaAt(x - 1, y - 1), lumaNE = lumaAt(x + 1, y - 1);
+            float lumaSW = lumaAt(x - 1, y + 1), lumaSE = lumaAt(x + 1, y + 1);
+            float lumaMin = std::min(lumaM, std::min(std::min(lumaNW, lumaNE), std::min(lumaSW, lumaSE)));
+            float lumaMax = std::max(lumaM, std::max(std::max(lumaNW, lumaNE), std::max(lumaSW, lumaSE)));
+            if (lumaMax - lumaMin < std::max(edgeThresholdMin, lumaMax * edgeThreshold)) continue;
+
+            float dirX = -((lumaNW + lumaNE) - (lumaSW + lumaSE));
+            float dirY = (lumaNW + lumaSW) - (lumaNE + lumaSE);
+            float dirReduce = std::max((lumaNW + lumaNE + lumaSW + lumaSE) * 0.25f * reduceMul, reduceMin);
+            float rcpDirMin = 1.0f / (std::min(fabsf(dirX), fabsf(dirY)) + dirReduce);
+            dirX = std::max(-spanMax, std::min(spanMax, dirX * rcpDirMin));
+            dirY = std::max(-spanMax, std::min(spanMax, dirY * rcpDirMin));
+
+            float a0[3], a1[3], b0[3], b1[3];
+            SampleTile(tile, source, x, y, dirX * (1.0f / 3.0f - 0.5f), dirY * (1.0f / 3.0f - 0.5f), a0);
+            SampleTile(tile, source, x, y, dirX * (2.0f / 3.0f - 0.5f), dirY * (2.0f / 3.0f - 0.5f), a1);
+            SampleTile(tile, source, x, y, -dirX * 0.5f, -dirY * 0.5f, b0);
+            SampleTile(tile, source, x, y, dirX * 0.5f, dirY * 0.5f, b1);
+            float rgbA[3], rgbB[3];
+            for (int k = 0; k < 3; k++) {
+                rgbA[k] = 0.5f * (a0[k] + a1[k]);
+                rgbB[k] = rgbA[k] * 0.5f + 0.25f * (b0[k] + b1[k]);
+            }
+            float lumaB = PostLuma(rgbB);
+            const float* chosen = lumaB < lumaMin || lumaB > lumaMax ? rgbA : rgbB;
+            float* out = tile.rgb + (y * tile.width + x) * 3;
+            for (int k = 0; k < 3; k++) out[k] = chosen[k];
+        }
+    }
+}
+
+// Runs the chain over the tile. Runs of per-pixel effects are fused into one sweep;
+// FXAA reads a copy in scratch, so it sees its neighbours from before the pass.
+inline void ApplyPostChain(const PostChain& chain, PostTile& tile, std::vector<float>& scratch) {
+    const std::vector<PostEffect>& effects = chain.GetEffects();
+    int pixelCount = tile.width * tile.height;
+    size_t e = 0;
+    while (e < effects.size()) {
+        if (effects[e].type == PostEffectType::FXAA) {
+            scratch.assign(tile.rgb, tile.rgb + pixelCount * 3);
+            ApplyFXAA(tile, scratch.data());
+            e++;
+            continue;
+        }
+        size_t end = e;
+        while (end < effects.size() && effects[end].type != PostEffectType::FXAA) end++;
+        for (int p = 0; p < pixelCount; p++) {
+            float* rgb = tile.rgb + p * 3;
+            for (size_t i = e; i < end; i++) {
+                ApplyPixelEffect(effects[i], tile, p, rgb);
+            }
+        }
+        e = end;
+    }
+}
@@ -1,51 +1,160 @@
 #include "Renderer.h"
+#include "Skinning.h"
+#include "VertexQuantization.h"
+#include "VirtualTexture.h"
 #include <cmath>
+#include <cstring>
+#include <climits>
+#include <algorithm>
+
+// Per-triangle overhead of visiting a tile, expressed in pixel-equivalents
+static const float kTriangleSetupCost = 16.0f;
+// Hot tiles are never split below this size
+static const int kMinSubTileSize = 16;
+// Filling a pixel with the clear colour, relative to rasterizing one
+static const float kClearCostPerPixel = 0.05f;
+// Depth range of every view's projection
+static const float kNearPlane = 0.1f;
+static const float kFarPlane = 1000.0f;
+
+static bool SameColor(Color a, Color b) {
+    return a.r == b.r && a.g == b.g && a.b == b.b && a.a == b.a;
+}
 
-Renderer::Renderer(int w, int h) : width(w), height(h), tileSize(64) {
-    pixelBuffer = new Color[width * height];
-    depthBuffer = new float[width * height];
-    Image img = GenImageColor(width, height, BLACK);
-    screenTexture = LoadTextureFromImage(img);
-    UnloadImage(img);
-    
-    uiFont = LoadFont("fonts/OpenSans.ttf");
+static bool SameVector(const Vector3S& a, const Vector3S& b) {
+    return a.x == b.x && a.y == b.y && a.z == b.z;
+}
+
+static bool SameLight(const LightS& a, const LightS& b) {
+    return a.type == b.type && SameVector(a.direction, b.direction) && SameVector(a.position, b.position) &&
+        a.spotAngle == b.spotAngle && a.intensity == b.intensity && a.castShadows == b.castShadows &&
+        a.shadowBias == b.shadowBias;
+}
+
+// Edge functions sum to twice the signed area everywhere; setup made them positive inside
+static float TriangleArea(const TriangleData& tri) {
+    return tri.edge[0][0] + tri.edge[1][0] + tri.edge[2][0];
+}
 
+Renderer::Renderer(int w, int h, bool headlessMode) : width(w), height(h), headless(headlessMode), tileSize(64) {
+    SetColorBuffers(new Color[width * height], new Color[width * height]);
+
+    // Headless renderers have no window or GPU context: frames only go to the sink
+    if (!headless) {
+        Image img = GenImageColor(width, height, BLACK);
+        screenTexture = LoadTextureFromImage(img);
+        UnloadImage(img);
+        
+        uiFont = LoadFont("fonts/OpenSans.ttf");
+    }
+
+    cpuKernels = &GetCpuKernels(SelectCpuLevel());
 #ifndef __EMSCRIPTEN__
-    numThreads = std::thread::hardware_concurrency();
-    if (numThreads == 0) numThreads = 4;
-    threadPool = std::make_unique<ThreadPool>(numThreads);
+    SetThreadCount(0);
 #endif
 
-    InitTiles();
+    for (FrameContext& frame : frames) {
+        InitTiles(frame, width, height);
+        ResetBinSlots(frame);
+    }
+    frameStartTime = lastRenderTime = Clock::now();
 }
 
 Renderer::~Renderer() {
-    UnloadFont(uiFont);
-    UnloadTexture(screenTexture);
-    delete[] pixelBuffer;
-    delete[] depthBuffer;
+#ifndef __EMSCRIPTEN__
+    // A pipelined frame may still be rasterizing into the buffers freed below
+    threadPool->WaitAll();
+#endif
+    if (!headless) {
+        UnloadFont(uiFont);
+        UnloadTexture(screenTexture);
+    }
+    if (!sharedFrames) {
+        for (FrameBuffer& buffer : buffers) {
+            delete[] buffer.color;
+        }
+    }
+    delete[] upscaleBuffer;
 }
 
-void Renderer::InitTiles() {
-    tilesX = (width + tileSize - 1) / tileSize;
-    tilesY = (height + tileSize - 1) / tileSize;
-    tiles.resize(tilesX * tilesY);
+// Swaps in new swap chain storage; nothing of either old buffer carries over
+void Renderer::SetColorBuffers(Color* first, Color* second) {
+    buffers[0].color = first;
+    buffers[1].color = second;
+    for (FrameBuffer& buffer : buffers) {
+        buffer.tileHoldsClear.clear();
+        buffer.fullyDirty = true;
+    }
+    pixelBuffer = buffers[backBuffer].color;
+}
+
+bool Renderer::EnableSharedFrames(const std::string& name) {
+    // No frame may still be rasterizing into the buffers being replaced
+    Finish();
+    auto ring = std::make_unique<SharedFrameRing>();
+    if (!ring->Create(name, width, height)) return false;
+
+    if (!sharedFrames) {
+        for (FrameBuffer& buffer : buffers) {
+            delete[] buffer.color;
+        }
+    }
+    SetColorBuffers(ring->GetPixels(0), ring->GetPixels(1));
+    sharedFrames = std::move(ring);
+    return true;
+}
 
-    for (int ty = 0; ty < tilesY; ty++) {
-        for (int tx = 0; tx < tilesX; tx++) {
-            Tile& tile = tiles[ty * tilesX + tx];
+void Renderer::DisableSharedFrames() {
+    if (!sharedFrames) return;
+    Finish();
+    SetColorBuffers(new Color[width * height], new Color[width * height]);
+    sharedFrames.reset();
+}
+
+// Lays out the tile grid for one frame; only called for the frame being recorded,
+// so a resolution or tile size change never disturbs a frame the workers are reading
+void Renderer::InitTiles(FrameContext& frame, int renderWidth, int renderHeight) {
+    frame.width = renderWidth;
+    frame.height = renderHeight;
+    frame.tileSize = tileSize;
+    frame.tilesX = (renderWidth + tileSize - 1) / tileSize;
+    frame.tilesY = (renderHeight + tileSize - 1) / tileSize;
+    frame.tiles.resize(frame.tilesX * frame.tilesY);
+
+    for (int ty = 0; ty < frame.tilesY; ty++) {
+        for (int tx = 0; tx < frame.tilesX; tx++) {
+            Tile& tile = frame.tiles[ty * frame.tilesX + tx];
             tile.startX = tx * tileSize;
             tile.startY = ty * tileSize;
-            tile.endX = std::min(tile.startX + tileSize, width);
-            tile.endY = std::min(tile.startY + tileSize, height);
-            tile.triangleIndices.reserve(644);
+            tile.endX = std::min(tile.startX + tileSize, renderWidth);
+            tile.endY = std::min(tile.startY + tileSize, renderHeight);
+            tile.triangleCount = 0;
+            tile.cost = 0.0f;
         }
     }
 }
 
 void Renderer::SetTileSize(int size) {
+    // Picked up by the next Clear
     tileSize = size;
-    InitTiles();
+}
+
+void Renderer::SetDynamicResolution(bool enabled, float targetMs, float minScale) {
+    dynamicResolution = enabled;
+    targetFrameMs = targetMs;
+    minResolutionScale = std::max(0.1f, std::min(1.0f, minScale));
+    if (!enabled) resolutionScale = 1.0f;
+}
+
+void Renderer::SetPostChain(const PostChain& chain) {
+    postChain = chain;
+    postChainVersion++;
+}
+
+void Renderer::SetCpuLevel(CpuLevel level) {
+    cpuKernels = &GetCpuKernels(level);
+    // Kept tiles were rendered by the previous kernels; redraw so every pixel uses the new ones
+    forceFullRedraw = true;
 }
 
 int Renderer::GetThreadCount() const {
@@ -56,6 +165,17 @@ int Renderer::GetThreadCount() const {
 #endif
 }
 
+void Renderer::SetThreadCount(int count) {
+#ifndef __EMSCRIPTEN__
+    if (threadPool) threadPool->WaitAll();
+    numThreads = count > 0 ? count : std::thread::hardware_concurrency();
+    if (numThreads == 0) numThreads = 4;
+    threadPool = std::make_unique<ThreadPool>(numThreads);
+#else
+    (void)count;    // Web builds rasterize on the main thread
+#endif
+}
+
 const char* Renderer::GetShadingModeName() const {
     switch (currentShadingMode) {
         case ShadingMode::Phong:   return "Phong";
@@ -67,53 +187,869 @@ const char* Renderer::GetShadingModeName() const {
     }
 }
 
+const char* Renderer::GetAntiAliasingName() const {
+    switch (antiAliasing) {
+        case AntiAliasing::None:   return "No AA";
+        case AntiAliasing::MSAA4x: return "MSAA 4x";
+        default:                   return "Unknown";
+    }
+}
+
+const char* Renderer::GetFrameModeName() const {
+    switch (frameMode) {
+        case FrameMode::LowLatency: return "Low latency";
+        case FrameMode::Pipelined:  return "Pipelined";
+        default:                    return "Unknown";
+    }
+}
+
+const char* Renderer::GetShadowQualityName() const {
+    switch (shadowQuality) {
+        case ShadowQuality::Off:    return "Shadows off";
+        case ShadowQuality::Hard:   return "Hard shadows";
+        case ShadowQuality::PCF3x3: return "PCF 3x3 shadows";
+        default:                    return "Unknown";
+    }
+}
+
+const char* Renderer::GetPerspectiveCorrectionName() const {
+    switch (perspectiveCorrection) {
+        case PerspectiveCorrection::Exact:  return "Exact perspective";
+        case PerspectiveCorrection::Span8:  return "Perspective every 8 px";
+        case PerspectiveCorrection::Span16: return "Perspective every 16 px";
+        default:                            return "Unknown";
+    }
+}
+
+void Renderer::ClearTiles(FrameContext& frame) {
+    for (auto& tile : frame.tiles) {
+        tile.triangleCount = 0;
+        tile.transparentCount = 0;
+        tile.cost = 0.0f;
+    }
+    ResetBinSlots(frame);
+    frame.views.clear();
+    frame.viewMVPs.clear();
+    frame.draws.clear();
+    frame.deformedVertices.clear();
+    frame.jointPalettes.clear();
+    frame.morphWeights.clear();
+}
+
+// O(slots): arenas rewind and bumping the generation empties every tile list at once
+void Renderer::ResetBinSlots(FrameContext& frame) {
+    size_t slotCount = std::max(1, GetThreadCount());
+    if (frame.binSlots.size() != slotCount) {
+        frame.binSlots.resize(slotCount);
+    }
+    for (BinSlot& slot : frame.binSlots) {
+        slot.triangles.Reset();
+        slot.chunks.Reset();
+        if (slot.tileBins.size() != frame.tiles.size()) {
+            slot.tileBins.assign(frame.tiles.size(), TileBin());
+            slot.generation = 0;
+        }
+        slot.generation++;
+    }
+}
+
+// Object-space vertices a draw is rendered from
+static const Vertex* GetDrawVertices(const FrameContext& frame, const DrawRecord& draw) {
+    return draw.deformedOffset >= 0 ? &frame.deformedVertices[draw.deformedOffset] : draw.mesh->vertices.data();
+}
+
+// The mesh's packed vertices when the draw reads those instead, or null
+static const PackedVertices* GetDrawPackedVertices(const DrawRecord& draw) {
+    return draw.deformedOffset < 0 && draw.mesh->packed.count ? &draw.mesh->packed : nullptr;
+}
 
-void Renderer::ClearTiles() {
-    for (auto& tile : tiles) {
-        tile.triangleIndices.clear();
+// Calls fn(triangle) for every triangle binned to a tile, in draw order
+template <typename Fn>
+static void ForEachTileTriangle(const FrameContext& frame, int tileIndex, Fn&& fn) {
+    for (const BinSlot& slot : frame.binSlots) {
+        const TileBin& bin = slot.tileBins[tileIndex];
+        if (bin.generation != slot.generation) continue;
+        for (int c = bin.head; c != -1; c = slot.chunks[c].next) {
+            const BinChunk& chunk = slot.chunks[c];
+            for (int i = 0; i < chunk.count; i++) {
+                fn(slot.triangles[chunk.indices[i]]);
+            }
+        }
     }
-    triangleBuffer.clear();
 }
 
-void Renderer::BinTriangleToTiles(int triangleIndex) {
-    const TriangleData& tri = triangleBuffer[triangleIndex];
+BinStats Renderer::GetBinStats() const {
+    BinStats stats;
+    for (const FrameContext& frame : frames) {
+        size_t triangles = 0, chunks = 0;
+        for (const BinSlot& slot : frame.binSlots) {
+            triangles += slot.triangles.HighWater();
+            chunks += slot.chunks.HighWater();
+            stats.reservedBytes += slot.triangles.Capacity() * sizeof(TriangleData) +
+                slot.chunks.Capacity() * sizeof(BinChunk) + slot.tileBins.capacity() * sizeof(TileBin);
+        }
+        stats.peakTriangles = std::max(stats.peakTriangles, triangles);
+        stats.peakBinChunks = std::max(stats.peakBinChunks, chunks);
+    }
+    return stats;
+}
 
-    int startTileX = std::max(0, tri.minX / tileSize);
-    int startTileY = std::max(0, tri.minY / tileSize);
-    int endTileX = std::min(tilesX - 1, tri.maxX / tileSize);
-    int endTileY = std::min(tilesY - 1, tri.maxY / tileSize);
+GeometryStats Renderer::GetGeometryStats() const {
+    GeometryStats stats;
+    for (const FrameContext& frame : frames) {
+        for (const BinSlot& slot : frame.binSlots) {
+            stats.meshlets += slot.geometry.meshlets;
+            stats.frustumCulled += slot.geometry.frustumCulled;
+            stats.backfaceCulled += slot.geometry.backfaceCulled;
+            stats.meshVertices += slot.geometry.meshVertices;
+            stats.shadedVertices += slot.geometry.shadedVertices;
+        }
+    }
+    return stats;
+}
+
+void Renderer::BinTriangleToTiles(const FrameContext& frame, BinSlot& slot, int triangleIndex) {
+    const TriangleData& tri = slot.triangles[triangleIndex];
+
+    // Tiles whose post halo the triangle reaches rasterize it too
+    int startTileX = std::max(0, (tri.minX - frame.postHalo) / frame.tileSize);
+    int startTileY = std::max(0, (tri.minY - frame.postHalo) / frame.tileSize);
+    int endTileX = std::min(frame.tilesX - 1, (tri.maxX + frame.postHalo) / frame.tileSize);
+    int endTileY = std::min(frame.tilesY - 1, (tri.maxY + frame.postHalo) / frame.tileSize);
 
     for (int ty = startTileY; ty <= endTileY; ty++) {
         for (int tx = startTileX; tx <= endTileX; tx++) {
-            tiles[ty * tilesX + tx].triangleIndices.push_back(triangleIndex);
+            int tileIndex = ty * frame.tilesX + tx;
+            const Tile& tile = frame.tiles[tileIndex];
+            TileBin& bin = slot.tileBins[tileIndex];
+            if (bin.generation != slot.generation) {
+                bin = TileBin();
+                bin.generation = slot.generation;
+            }
+            if (bin.tail == -1 || slot.chunks[bin.tail].count == kBinChunkSize) {
+                int chunkIndex = (int)slot.chunks.Allocate();
+                slot.chunks[chunkIndex].count = 0;
+                slot.chunks[chunkIndex].next = -1;
+                if (bin.tail == -1) {
+                    bin.head = chunkIndex;
+                } else {
+                    slot.chunks[bin.tail].next = chunkIndex;
+                }
+                bin.tail = chunkIndex;
+            }
+            BinChunk& chunk = slot.chunks[bin.tail];
+            chunk.indices[chunk.count++] = triangleIndex;
+            bin.count++;
+            if (tri.alpha != 255) bin.transparentCount++;
+            bin.cost += EstimateTriangleCost(tri, tile.startX, tile.startY, tile.endX, tile.endY);
         }
     }
 }
 
+// Folds every slot's per-tile counts and costs into the tiles
+void Renderer::MergeBins(FrameContext& frame) {
+    for (size_t i = 0; i < frame.tiles.size(); i++) {
+        Tile& tile = frame.tiles[i];
+        tile.triangleCount = 0;
+        tile.transparentCount = 0;
+        tile.cost = 0.0f;
+        for (const BinSlot& slot : frame.binSlots) {
+            const TileBin& bin = slot.tileBins[i];
+            if (bin.generation != slot.generation) continue;
+            tile.triangleCount += bin.count;
+            tile.transparentCount += bin.transparentCount;
+            tile.cost += bin.cost;
+        }
+    }
+}
+
+// Cost of a triangle within a rectangle: its bounding box overlap, capped by the
+// triangle's own area, plus a fixed setup cost for visiting it at all
+float Renderer::EstimateTriangleCost(const TriangleData& tri, int startX, int startY, int endX, int endY) const {
+    int overlapW = std::min(tri.maxX + 1, endX) - std::max((int)tri.minX, startX);
+    int overlapH = std::min(tri.maxY + 1, endY) - std::max((int)tri.minY, startY);
+    if (overlapW <= 0 || overlapH <= 0) return 0.0f;
+
+    float covered = std::min((float)(overlapW * overlapH), TriangleArea(tri) * 0.5f);
+    return kTriangleSetupCost + covered;
+}
+
+void Renderer::SplitTileJob(const FrameContext& frame, const TileJob& job, float targetCost, int minSize) {
+    int w = job.endX - job.startX;
+    int h = job.endY - job.startY;
+    if (job.cost <= targetCost || (w < minSize * 2 && h < minSize * 2)) {
+        tileJobs.push_back(job);
+        return;
+    }
+
+    // Split along the longer side and re-estimate each half from the tile's bin
+    TileJob halves[2] = {job, job};
+    if (w >= h) {
+        int midX = job.startX + w / 2;
+        halves[0].endX = midX;
+        halves[1].startX = midX;
+    } else {
+        int midY = job.startY + h / 2;
+        halves[0].endY = midY;
+        halves[1].startY = midY;
+    }
+
+    for (TileJob& half : halves) {
+        half.cost = 0.0f;
+        ForEachTileTriangle(frame, job.tileIndex, [&](const TriangleData& tri) {
+            half.cost += EstimateTriangleCost(tri, half.startX, half.startY, half.endX, half.endY);
+        });
+        if (half.cost > 0.0f) {
+            SplitTileJob(frame, half, targetCost, minSize);
+        } else {
+            // Still owns its pixels: the job clears them
+            tileJobs.push_back(half);
+        }
+    }
+}
+
+void Renderer::BuildTileJobs(const FrameContext& frame) {
+    tileJobs.clear();
+
+    float totalCost = 0.0f;
+    for (const Tile& tile : frame.tiles) {
+        totalCost += tile.cost;
+    }
+
+    // Aim for several jobs per worker so no single tile becomes the long pole
+    float targetCost = totalCost / (float)(GetThreadCount() * 4);
+
+    FrameBuffer& buffer = buffers[backBuffer];
+    std::vector<unsigned char>& holdsClear = buffer.tileHoldsClear;
+    if (!SameColor(buffer.clearColor, frame.clearColor) || buffer.width != frame.width || buffer.height != frame.height ||
+        holdsClear.size() != frame.tiles.size() || buffer.postVersion != frame.postVersion) {
+        holdsClear.assign(frame.tiles.size(), 0);
+        buffer.clearColor = frame.clearColor;
+        buffer.postVersion = frame.postVersion;
+    }
+    bool redrawAll = !incrementalRendering || buffer.fullyDirty || buffer.width != frame.width ||
+        buffer.height != frame.height || buffer.pendingDirty.size() != frame.tiles.size();
+    buffer.width = frame.width;
+    buffer.height = frame.height;
+    buffer.frameNumber = ++renderedFrames;
+    buffer.tilesX = frame.tilesX;
+    buffer.tileSize = frame.tileSize;
+    buffer.tilesWritten.assign(frame.tiles.size(), 0);
+
+    // A tile left empty two frames running shows the same clear colour in both
+    EmptyTiles& previous = previousEmptyTiles;
+    bool sameGrid = previous.width == frame.width && previous.height == frame.height &&
+        previous.tileSize == frame.tileSize && SameColor(previous.clearColor, frame.clearColor) &&
+        previous.postVersion == frame.postVersion;
+    previous.empty.resize(frame.tiles.size());
+    for (int i = 0; i < (int)frame.tiles.size(); i++) {
+        const Tile& tile = frame.tiles[i];
+        TileJob job = {i, tile.startX, tile.startY, tile.endX, tile.endY, tile.cost};
+        bool empty = tile.triangleCount == 0;
+        bool emptyBefore = sameGrid && previous.empty[i];
+        previous.empty[i] = empty;
+
+        // Clean tile: its pixels from the last frame in this buffer are still right, and
+        // as nothing changed there since, they match the frame before this one too
+        if (!redrawAll && !buffer.pendingDirty[i]) continue;
+        buffer.tilesWritten[i] = !(empty && emptyBefore);
+
+        if (tile.triangleCount == 0) {
+            // Untouched tile: fill it only if it doesn't already hold the clear colour
+            if (holdsClear[i]) continue;
+            holdsClear[i] = 1;
+            job.cost = (tile.endX - tile.startX) * (tile.endY - tile.startY) * kClearCostPerPixel;
+            tileJobs.push_back(job);
+            continue;
+        }
+
+        holdsClear[i] = 0;
+        if (GetThreadCount() > 1) {
+            SplitTileJob(frame, job, targetCost, kMinSubTileSize);
+        } else {
+            tileJobs.push_back(job);
+        }
+    }
+
+    // Largest-cost-first so expensive jobs start early and cheap ones fill the gaps
+    std::sort(tileJobs.begin(), tileJobs.end(), [](const TileJob& a, const TileJob& b) {
+        return a.cost > b.cost;
+    });
+
+    previous.width = frame.width;
+    previous.height = frame.height;
+    previous.tileSize = frame.tileSize;
+    previous.clearColor = frame.clearColor;
+    previous.postVersion = frame.postVersion;
+    buffer.pendingDirty.assign(frame.tiles.size(), 0);
+    buffer.fullyDirty = false;
+}
+
+bool Renderer::ViewChanged(const FrameContext& frame) const {
+    if (frame.width != previousView.width || frame.height != previousView.height ||
+        frame.tileSize != previousView.tileSize || frame.shadingMode != previousView.shadingMode ||
+        frame.antiAliasing != previousView.antiAliasing || !SameColor(frame.clearColor, previousView.clearColor) ||
+        frame.views.size() != previousView.views.size() || frame.shadowQuality != previousView.shadowQuality ||
+        frame.perspectiveCorrection != previousView.perspectiveCorrection || frame.lights.size() != previousView.lights.size() ||
+        frame.postVersion != previousView.postVersion) {
+        return true;
+    }
+    for (size_t i = 0; i < frame.views.size(); i++) {
+        if (memcmp(&frame.views[i], &previousView.views[i], sizeof(ViewS)) != 0) return true;
+    }
+    for (size_t i = 0; i < frame.lights.size(); i++) {
+        if (!SameLight(frame.lights[i], previousView.lights[i])) return true;
+    }
+    return false;
+}
+
+void Renderer::MarkDirtyBounds(const FrameContext& frame, int minX, int minY, int maxX, int maxY) {
+    if (minX > maxX || minY > maxY) return;
+    // Neighbourhood post effects carry a change into the pixels around it
+    minX = std::max(0, minX - frame.postHalo);
+    minY = std::max(0, minY - frame.postHalo);
+    maxX += frame.postHalo;
+    maxY += frame.postHalo;
+
+    int startTileX = std::max(0, minX / frame.tileSize);
+    int startTileY = std::max(0, minY / frame.tileSize);
+    int endTileX = std::min(frame.tilesX - 1, maxX / frame.tileSize);
+    int endTileY = std::min(frame.tilesY - 1, maxY / frame.tileSize);
+
+    for (int ty = startTileY; ty <= endTileY; ty++) {
+        for (int tx = startTileX; tx <= endTileX; tx++) {
+            frameDirty[ty * frame.tilesX + tx] = 1;
+        }
+    }
+}
+
+// Diffs this frame's draws against the last one. Tiles under the old and new bounds
+// of every changed, added or removed object are dirty; the result is merged into each
+// buffer's pending set, since a pipelined buffer last saw the frame before the previous one.
+void Renderer::UpdateDirtyTiles(const FrameContext& frame) {
+    bool full = !incrementalRendering || forceFullRedraw || ViewChanged(frame);
+    forceFullRedraw = false;
+
+    frameDirty.assign(frame.tiles.size(), 0);
+    bool anyChanged = false;
+    currentDraws.clear();
+    for (size_t i = 0; i < frame.draws.size(); i++) {
+        currentDraws.push_back({frame.draws[i].object, (int)i, frame.draws[i]});
+    }
+    // Sorting by submission order within each object turns the order into the occurrence
+    auto byKey = [](const TrackedDraw& a, const TrackedDraw& b) {
+        return a.object != b.object ? a.object < b.object : a.occurrence < b.occurrence;
+    };
+    std::sort(currentDraws.begin(), currentDraws.end(), byKey);
+    for (size_t i = 0; i < currentDraws.size(); i++) {
+        bool sameObject = i > 0 && currentDraws[i - 1].object == currentDraws[i].object;
+        currentDraws[i].occurrence = sameObject ? currentDraws[i - 1].occurrence + 1 : 0;
+    }
+
+    // Both lists are sorted by key: walk them together
+    size_t p = 0;
+    for (size_t c = 0; c < currentDraws.size() && !full; c++) {
+        const DrawRecord& draw = currentDraws[c].draw;
+        while (p < previousDraws.size() && byKey(previousDraws[p], currentDraws[c])) {
+            const DrawRecord& gone = previousDraws[p++].draw;
+            MarkDirtyBounds(frame, gone.minX, gone.minY, gone.maxX, gone.maxY);
+            anyChanged = true;
+        }
+        if (p == previousDraws.size() || byKey(currentDraws[c], previousDraws[p])) {
+            MarkDirtyBounds(frame, draw.minX, draw.minY, draw.maxX, draw.maxY);
+            anyChanged = true;
+            continue;
+        }
+
+        const DrawRecord& old = previousDraws[p++].draw;
+        bool changed = old.mesh != draw.mesh || old.indexCount != draw.indexCount || old.texture != draw.texture ||
+            old.textureVersion != draw.textureVersion || old.alpha != draw.alpha || memcmp(&old.world, &draw.world, sizeof(Matrix4x4)) != 0 ||
+            old.deformedOffset >= 0 || draw.deformedOffset >= 0;   // Poses are not kept to compare
+        if (changed) {
+            MarkDirtyBounds(frame, old.minX, old.minY, old.maxX, old.maxY);
+            MarkDirtyBounds(frame, draw.minX, draw.minY, draw.maxX, draw.maxY);
+            anyChanged = true;
+        }
+    }
+    for (; p < previousDraws.size() && !full; p++) {
+        const DrawRecord& gone = previousDraws[p].draw;
+        MarkDirtyBounds(frame, gone.minX, gone.minY, gone.maxX, gone.maxY);
+        anyChanged = true;
+    }
+    // A moving caster refits the light's map and its shadow can land on any receiver; pixels
+    // outside every draw only ever hold the clear colour
+    if (anyChanged && ShadowsActive(frame) && !full) {
+        for (const TrackedDraw& receiver : currentDraws) {
+            MarkDirtyBounds(frame, receiver.draw.minX, receiver.draw.minY, receiver.draw.maxX, receiver.draw.maxY);
+        }
+    }
+
+    previousDraws.swap(currentDraws);
+    previousView.width = frame.width;
+    previousView.height = frame.height;
+    previousView.tileSize = frame.tileSize;
+    previousView.shadingMode = frame.shadingMode;
+    previousView.antiAliasing = frame.antiAliasing;
+    previousView.clearColor = frame.clearColor;
+    previousView.views = frame.views;
+    previousView.lights = frame.lights;
+    previousView.shadowQuality = frame.shadowQuality;
+    previousView.perspectiveCorrection = frame.perspectiveCorrection;
+    previousView.postVersion = frame.postVersion;
+
+    for (FrameBuffer& buffer : buffers) {
+        if (full || buffer.pendingDirty.size() != frameDirty.size()) {
+            buffer.fullyDirty = true;
+            continue;
+        }
+        for (size_t i = 0; i < frameDirty.size(); i++) {
+            buffer.pendingDirty[i] |= frameDirty[i];
+        }
+    }
+}
+
+// Starts recording a new frame. No pixels are touched here: each tile is
+// cleared by the job that rasterizes it, while its lines are hot in that worker's cache.
 void Renderer::Clear(Color color) {
+    frameStartTime = Clock::now();
+    if (dynamicResolution) {
+        UpdateResolutionScale();
+    }
+
+    FrameContext& frame = frames[recordFrame];
+    int renderWidth = std::max(1, (int)(width * resolutionScale + 0.5f));
+    int renderHeight = std::max(1, (int)(height * resolutionScale + 0.5f));
+    if (frame.width != renderWidth || frame.height != renderHeight || frame.tileSize != tileSize) {
+        InitTiles(frame, renderWidth, renderHeight);
+    }
+
+    ClearTiles(frame);
+    frame.clearColor = color;
+    frame.lights = lights;
+    frame.kernels = cpuKernels;
+    if (frame.postVersion != postChainVersion) {
+        frame.post = postChain;
+        frame.postVersion = postChainVersion;
+        frame.postHalo = postChain.GetHalo();
+    }
+    // Pipelined frames bin inside DrawMesh, overlapping the previous frame's raster.
+    // Low-latency workers are idle until Render, so binning waits for them there.
+    frame.deferGeometry = frameMode == FrameMode::LowLatency && GetThreadCount() > 1;
+}
+
+// Scales the internal resolution so the raster stage fits what is left of the
+// frame budget once resolution-independent work (geometry, present) is paid for.
+// Drops quickly when over budget, recovers slowly to avoid oscillating.
+void Renderer::UpdateResolutionScale() {
+    if (timings.frameMs <= 0.0f || timings.rasterMs <= 0.0f) return;
+
+    float fixedMs = std::max(0.0f, timings.frameMs - timings.rasterMs);
+    float rasterBudget = targetFrameMs - fixedMs;
+    float scale = minResolutionScale;
+    if (rasterBudget > 0.0f) {
+        // Raster cost scales with pixel count, i.e. with scale squared
+        scale = resolutionScale * sqrtf(rasterBudget / timings.rasterMs);
+        scale = std::max(resolutionScale * 0.8f, std::min(resolutionScale * 1.05f, scale));
+    }
+    scale = std::max(minResolutionScale, std::min(1.0f, scale));
+
+    if (std::abs(scale - resolutionScale) > 0.02f || scale == 1.0f || scale == minResolutionScale) {
+        resolutionScale = scale;
+    }
+}
+
+// Runs fn(0) .. fn(count - 1) on the workers and waits for all of them
+void Renderer::ParallelFor(int count, const std::function<void(int)>& fn) {
 #ifndef __EMSCRIPTEN__
-    int pixelsPerThread = (width * height + numThreads - 1) / numThreads;
-    for (unsigned int t = 0; t < numThreads; t++) {
-        threadPool->Enqueue([this, t, pixelsPerThread, color]() {
-            int start = t * pixelsPerThread;
-            int end = std::min(start + pixelsPerThread, width * height);
-            for (int i = start; i < end; i++) {
-                pixelBuffer[i] = color;
-                depthBuffer[i] = std::numeric_limits<float>::max();
+    for (int i = 0; i < count; i++) {
+        threadPool->Enqueue([&fn, i]() { fn(i); });
+    }
+    threadPool->WaitAll();
+#else
+    for (int i = 0; i < count; i++) {
+        fn(i);
+    }
+#endif
+}
+
+bool Renderer::ShadowsActive(const FrameContext& frame) const {
+    if (frame.shadowQuality == ShadowQuality::Off) return false;
+    for (const LightS& light : frame.lights) {
+        if (light.castShadows) return true;
+    }
+    return false;
+}
+
+// Depth-only pass for every shadow-casting light, finished before any colour job starts.
+// World-space caster positions are shared by all lights; each light then projects and sets
+// up its triangles per draw, and the map is rasterized in horizontal bands so no two
+// workers ever write the same texel.
+void Renderer::RenderShadowMaps(FrameContext& frame) {
+    frame.shadowMaps.resize(frame.lights.size());
+    for (ShadowMap& map : frame.shadowMaps) {
+        map.valid = false;
+    }
+    if (!ShadowsActive(frame) || frame.draws.empty()) return;
+
+    int drawCount = (int)frame.draws.size();
+    shadowCasterVertices.resize(drawCount);
+    shadowCasterBounds.resize(drawCount * 2);
+    ParallelFor(drawCount, [&](int d) {
+        const DrawRecord& draw = frame.draws[d];
+        const Matrix4x4& matWorld = draw.world;
+        const Vertex* vertices = GetDrawVertices(frame, draw);
+        const PackedVertices* packed = GetDrawPackedVertices(draw);
+        std::vector<Vector3S>& world = shadowCasterVertices[d];
+        world.resize(draw.mesh->GetVertexCount());
+
+        const float big = std::numeric_limits<float>::max();
+        Vector3S lo = {big, big, big};
+        Vector3S hi = {-big, -big, -big};
+        for (size_t i = 0; i < world.size(); i++) {
+            Vector3S p = MultiplyVectorMatrix(packed ? DecodePackedPosition(*packed, (uint32_t)i) : vertices[i].position, matWorld);
+            world[i] = p;
+            lo = {std::min(lo.x, p.x), std::min(lo.y, p.y), std::min(lo.z, p.z)};
+            hi = {std::max(hi.x, p.x), std::max(hi.y, p.y), std::max(hi.z, p.z)};
+        }
+        shadowCasterBounds[d * 2] = lo;
+        shadowCasterBounds[d * 2 + 1] = hi;
+    });
+
+    Vector3S boundsMin = shadowCasterBounds[0];
+    Vector3S boundsMax = shadowCasterBounds[1];
+    for (int d = 1; d < drawCount; d++) {
+        const Vector3S& lo = shadowCasterBounds[d * 2];
+        const Vector3S& hi = shadowCasterBounds[d * 2 + 1];
+        boundsMin = {std::min(boundsMin.x, lo.x), std::min(boundsMin.y, lo.y), std::min(boundsMin.z, lo.z)};
+        boundsMax = {std::max(boundsMax.x, hi.x), std::max(boundsMax.y, hi.y), std::max(boundsMax.z, hi.z)};
+    }
+    if (boundsMin.x > boundsMax.x) return;  // No vertices at all
+
+    std::vector<int>& casters = shadowCasters;
+    casters.clear();
+    for (size_t i = 0; i < frame.lights.size(); i++) {
+        if (!frame.lights[i].castShadows) continue;
+        frame.shadowMaps[i].Resize(shadowMapSize);
+        frame.shadowMaps[i].Setup(frame.lights[i], boundsMin, boundsMax);
+        casters.push_back((int)i);
+    }
+
+    shadowTriangles.resize(frame.lights.size() * drawCount);
+    // Lambdas capture no more than std::function stores inline, so none of this allocates
+    ParallelFor((int)casters.size() * drawCount, [this, &frame](int job) {
+        int drawCount = (int)frame.draws.size();
+        SetupShadowTriangles(frame, shadowCasters[job / drawCount], job % drawCount);
+    });
+
+    const int bandHeight = 64;
+    std::vector<std::pair<int, int>>& bands = shadowBands;
+    bands.clear();
+    for (int light : casters) {
+        for (int y = 0; y < frame.shadowMaps[light].size; y += bandHeight) {
+            bands.push_back({light, y});
+        }
+    }
+    ParallelFor((int)bands.size(), [this, &frame](int job) {
+        int drawCount = (int)frame.draws.size();
+        int light = shadowBands[job].first;
+        ShadowMap& map = frame.shadowMaps[light];
+        int startY = shadowBands[job].second;
+        int endY = std::min(map.size, startY + bandHeight);
+        map.ClearRows(startY, endY);
+        for (int d = 0; d < drawCount; d++) {
+            for (const ShadowTriangle& tri : shadowTriangles[light * drawCount + d]) {
+                if (tri.maxY < startY || tri.minY >= endY) continue;
+                map.RasterizeTriangle(tri, startY, endY);
+            }
+        }
+    });
+
+    for (int light : casters) {
+        frame.shadowMaps[light].valid = true;
+    }
+}
+
+// Light-space projection, clipping and fixed-point setup of one draw's triangles.
+// Positions only: nothing else about the vertex matters to a depth-only pass.
+void Renderer::SetupShadowTriangles(const FrameContext& frame, int lightIndex, int drawIndex) {
+    const ShadowMap& map = frame.shadowMaps[lightIndex];
+    const LightS& light = frame.lights[lightIndex];
+    const DrawRecord& draw = frame.draws[drawIndex];
+    const std::vector<Vector3S>& world = shadowCasterVertices[drawIndex];
+    std::vector<ShadowTriangle>& out = shadowTriangles[lightIndex * frame.draws.size() + drawIndex];
+    out.clear();
+
+    static thread_local std::vector<Vector4S> clip;
+    clip.resize(world.size());
+    for (size_t i = 0; i < world.size(); i++) {
+        clip[i] = MultiplyVectorMatrix4(world[i], map.viewProj);
+    }
+
+    // A triangle clipped by six planes has at most nine vertices
+    Vector4S polygon[12], clipped[12];
+    for (size_t i = 0; i + 2 < draw.indexCount; i += 3) {
+        int count = 3;
+        polygon[0] = clip[draw.mesh->indices[i]];
+        polygon[1] = clip[draw.mesh->indices[i + 1]];
+        polygon[2] = clip[draw.mesh->indices[i + 2]];
+
+        for (int plane = 0; plane < 6 && count >= 3; plane++) {
+            int outCount = 0;
+            for (int v = 0; v < count; v++) {
+                const Vector4S& a = polygon[v];
+                const Vector4S& b = polygon[(v + 1) % count];
+                float da = GetPlaneDistance(a, plane);
+                float db = GetPlaneDistance(b, plane);
+                if (da >= 0) clipped[outCount++] = a;
+                if ((da >= 0) != (db >= 0)) {
+                    float t = da / (da - db);
+                    clipped[outCount++] = {a.x + t * (b.x - a.x), a.y + t * (b.y - a.y),
+                                           a.z + t * (b.z - a.z), a.w + t * (b.w - a.w)};
+                }
+            }
+            count = outCount;
+            std::copy(clipped, clipped + count, polygon);
+        }
+        if (count < 3) continue;
+
+        Vector3S screen[12];
+        for (int v = 0; v < count; v++) {
+            float invW = 1.0f / polygon[v].w;
+            screen[v] = {(polygon[v].x * invW + 1.0f) * 0.5f * map.size,
+                         (polygon[v].y * invW + 1.0f) * 0.5f * map.size,
+                         polygon[v].z * invW};
+        }
+        for (int v = 1; v + 1 < count; v++) {
+            ShadowTriangle tri;
+            if (ShadowMap::SetupTriangle(screen[0], screen[v], screen[v + 1], light.shadowBias, map.size, tri)) {
+                out.push_back(tri);
+            }
+        }
+    }
+}
+
+void Renderer::DispatchRaster(const FrameContext& frame) {
+    UpdateDirtyTiles(frame);
+    BuildTileJobs(frame);
+
+    rasterFrame = &frame;
+    pixelBuffer = buffers[backBuffer].color;
+    if (sharedFrames) sharedFrames->BeginWrite(backBuffer);
+    rasterStartTime = Clock::now();
+    rasterEndTime = rasterStartTime;
+
+#ifndef __EMSCRIPTEN__
+    rasterJobsRemaining = (int)tileJobs.size();
+    for (size_t i = 0; i < tileJobs.size(); i++) {
+        // Capture the index, not the job: small enough for std::function to store inline
+        threadPool->Enqueue([this, i]() {
+            RasterizeTile(tileJobs[i]);
+            if (--rasterJobsRemaining == 0) {
+                rasterEndTime = Clock::now();
             }
         });
     }
-    threadPool->WaitAll();
 #else
-    for (int i = 0; i < width * height; i++) {
-        pixelBuffer[i] = color;
-        depthBuffer[i] = std::numeric_limits<float>::max();
+    for (const TileJob& job : tileJobs) {
+        RasterizeTile(job);
     }
+    rasterEndTime = Clock::now();
 #endif
 }
 
 void Renderer::Render() {
-    UpdateTexture(screenTexture, pixelBuffer);
+    FrameContext& frame = frames[recordFrame];
+    frame.shadingMode = currentShadingMode;
+    frame.antiAliasing = antiAliasing;
+    frame.shadowQuality = shadowQuality;
+    frame.perspectiveCorrection = perspectiveCorrection;
+
+    Clock::time_point now = Clock::now();
+    float recordMs = std::chrono::duration<float, std::milli>(now - frameStartTime).count();
+    timings.frameMs = std::chrono::duration<float, std::milli>(now - lastRenderTime).count();
+    lastRenderTime = now;
+
+#ifndef __EMSCRIPTEN__
+    // Previous pipelined frame's raster must finish before its buffers are reused
+    threadPool->WaitAll();
+    if (frameMode == FrameMode::Pipelined && previousFrameReady) {
+        timings.rasterMs = std::chrono::duration<float, std::milli>(rasterEndTime - rasterStartTime).count();
+    }
+#endif
+
+    UpdateVirtualTextures(frame);
+
+    Clock::time_point binStart = Clock::now();
+    DeformDraws(frame);
+    BinDraws(frame);
+    MergeBins(frame);
+    timings.geometryMs = recordMs + std::chrono::duration<float, std::milli>(Clock::now() - binStart).count();
+
+    Clock::time_point shadowStart = Clock::now();
+    RenderShadowMaps(frame);
+    timings.shadowMs = std::chrono::duration<float, std::milli>(Clock::now() - shadowStart).count();
+
+    DispatchRaster(frame);
+
+#ifndef __EMSCRIPTEN__
+    if (frameMode == FrameMode::Pipelined) {
+        // Upload the last completed frame while the workers rasterize this one
+        Present(previousFrameReady ? &buffers[backBuffer ^ 1] : nullptr);
+        previousFrameReady = true;
+        backBuffer ^= 1;
+        recordFrame ^= 1;
+        return;
+    }
+    threadPool->WaitAll();
+#endif
+
+    timings.rasterMs = std::chrono::duration<float, std::milli>(rasterEndTime - rasterStartTime).count();
+    previousFrameReady = false;
+    Present(&buffers[backBuffer]);
+}
+
+// Bilinear upscale of the source's internal-resolution region to the full output size
+void Renderer::UpscaleRows(const FrameBuffer& source, int startY, int endY) {
+    const int fracBits = 8;
+    const int one = 1 << fracBits;
+    float stepX = (float)source.width / width;
+    float stepY = (float)source.height / height;
+
+    for (int y = startY; y < endY; y++) {
+        float sy = std::max(0.0f, (y + 0.5f) * stepY - 0.5f);
+        int y0 = std::min((int)sy, source.height - 1);
+        int y1 = std::min(y0 + 1, source.height - 1);
+        int fy = (int)((sy - y0) * one);
+        const Color* row0 = source.color + y0 * width;
+        const Color* row1 = source.color + y1 * width;
+        Color* dst = upscaleBuffer + y * width;
+
+        for (int x = 0; x < width; x++) {
+            float sx = std::max(0.0f, (x + 0.5f) * stepX - 0.5f);
+            int x0 = std::min((int)sx, source.width - 1);
+            int x1 = std::min(x0 + 1, source.width - 1);
+            int fx = (int)((sx - x0) * one);
+
+            const Color& c00 = row0[x0];
+            const Color& c10 = row0[x1];
+            const Color& c01 = row1[x0];
+            const Color& c11 = row1[x1];
+            auto lerp2 = [&](int a, int b, int c, int d) {
+                int top = a * (one - fx) + b * fx;
+                int bottom = c * (one - fx) + d * fx;
+                return (unsigned char)((top * (one - fy) + bottom * fy) >> (2 * fracBits));
+            };
+            dst[x] = {
+                lerp2(c00.r, c10.r, c01.r, c11.r),
+                lerp2(c00.g, c10.g, c01.g, c11.g),
+                lerp2(c00.b, c10.b, c01.b, c11.b),
+                255
+            };
+        }
+    }
+}
+
+void Renderer::Finish() {
+#ifndef __EMSCRIPTEN__
+    if (previousFrameReady) {
+        threadPool->WaitAll();
+        Present(&buffers[backBuffer ^ 1]);
+        previousFrameReady = false;
+    }
+#endif
+}
+
+// Full-resolution pixels of a completed frame, upscaled if it was rendered smaller
+const Color* Renderer::GetOutputPixels(const FrameBuffer& frameBuffer) {
+    if (frameBuffer.width == width && frameBuffer.height == height) {
+        return frameBuffer.color;
+    }
+
+    if (!upscaleBuffer) upscaleBuffer = new Color[width * height];
+#ifndef __EMSCRIPTEN__
+    if (frameMode == FrameMode::LowLatency) {
+        // Workers are idle between frames: spread the upscale across them
+        int rowsPerThread = (height + numThreads - 1) / numThreads;
+        for (unsigned int t = 0; t < numThreads; t++) {
+            int startY = t * rowsPerThread;
+            int endY = std::min(startY + rowsPerThread, height);
+            threadPool->Enqueue([this, &frameBuffer, startY, endY]() {
+                UpscaleRows(frameBuffer, startY, endY);
+            });
+        }
+        threadPool->WaitAll();
+    } else {
+        // Workers are busy with the next frame; the main thread would only be waiting
+        UpscaleRows(frameBuffer, 0, height);
+    }
+#else
+    UpscaleRows(frameBuffer, 0, height);
+#endif
+    return upscaleBuffer;
+}
+
+// screenTexture holds the frame before this one in the usual case, and then only tiles
+// written this frame differ. Consecutive tile rows with written tiles go up as one
+// rectangle spanning their written columns; full-width ones straight from the buffer.
+void Renderer::UploadFrame(const FrameBuffer& frameBuffer, const Color* pixels) {
+    bool partial = frameBuffer.frameNumber == uploadedFrame + 1 && pixels == frameBuffer.color;
+    uploadedFrame = frameBuffer.frameNumber;
+    if (!partial) {
+        UpdateTexture(screenTexture, pixels);
+        return;
+    }
+
+    int tilesX = frameBuffer.tilesX;
+    int tilesY = (int)frameBuffer.tilesWritten.size() / tilesX;
+    int ty = 0;
+    while (ty < tilesY) {
+        int minTileX = tilesX, maxTileX = -1;
+        int endTileY = ty;
+        for (; endTileY < tilesY; endTileY++) {
+            const unsigned char* row = &frameBuffer.tilesWritten[endTileY * tilesX];
+            int first = 0, last = tilesX - 1;
+            while (first < tilesX && !row[first]) first++;
+            if (first == tilesX) break;
+            while (!row[last]) last--;
+            minTileX = std::min(minTileX, first);
+            maxTileX = std::max(maxTileX, last);
+        }
+        if (endTileY == ty) {
+            ty++;
+            continue;
+        }
+
+        int x0 = minTileX * frameBuffer.tileSize;
+        int x1 = std::min(width, (maxTileX + 1) * frameBuffer.tileSize);
+        int y0 = ty * frameBuffer.tileSize;
+        int y1 = std::min(height, endTileY * frameBuffer.tileSize);
+        Rectangle rect = {(float)x0, (float)y0, (float)(x1 - x0), (float)(y1 - y0)};
+        if (x1 - x0 == width) {
+            UpdateTextureRec(screenTexture, rect, pixels + y0 * width);
+        } else {
+            uploadStaging.resize((size_t)(x1 - x0) * (y1 - y0));
+            for (int y = y0; y < y1; y++) {
+                memcpy(&uploadStaging[(size_t)(y - y0) * (x1 - x0)], pixels + y * width + x0, (x1 - x0) * sizeof(Color));
+            }
+            UpdateTextureRec(screenTexture, rect, uploadStaging.data());
+        }
+        ty = endTileY;
+    }
+}
+
+void Renderer::Present(const FrameBuffer* frameBuffer) {
+    if (frameBuffer && sharedFrames) {
+        sharedFrames->Publish((int)(frameBuffer - buffers), frameBuffer->width, frameBuffer->height);
+    }
+    const Color* pixels = frameBuffer ? GetOutputPixels(*frameBuffer) : nullptr;
+    if (pixels && frameSink) {
+        frameSink(pixels, width, height);
+    }
+    if (headless) return;
+
+    if (pixels) {
+        UploadFrame(*frameBuffer, pixels);
+    }
     BeginDrawing();
     ClearBackground(RAYWHITE);
     DrawTexture(screenTexture, 0, 0, WHITE);
@@ -121,6 +1057,13 @@ void Renderer::Render() {
     int fps = GetFPS();
     const char* fpsText = TextFormat("FPS: %d", fps);
     DrawTextEx(uiFont, fpsText, {10, 10}, 24, 1, DARKGRAY);
+    const char* modeText = TextFormat("%s, %s, %s, %s, %s", GetFrameModeName(), GetAntiAliasingName(), GetShadowQualityName(),
+                                      GetPerspectiveCorrectionName(), GetCpuLevelName());
+    DrawTextEx(uiFont, modeText, {10, 38}, 18, 1, DARKGRAY);
+    if (dynamicResolution) {
+        const char* resText = TextFormat("Resolution %d%%", (int)(resolutionScale * 100.0f + 0.5f));
+        DrawTextEx(uiFont, resText, {10, 60}, 18, 1, DARKGRAY);
+    }
     
     const char* shaderText = TextFormat("Shader: %s", GetShadingModeName());
     Vector2 textSize = MeasureTextEx(uiFont, shaderText, 24, 1);
@@ -168,80 +1111,499 @@ float EdgeFunction(Vector3S a, Vector3S b, Vector3S p) {
     return (p.x - a.x) * (b.y - a.y) - (p.y - a.y) * (b.x - a.x);
 }
 
-void Renderer::RasterizeTriangleInTile(const TriangleData& tri, const Tile& tile, const CameraS& cam) {
-    int minX = std::max(tri.minX, tile.startX);
-    int minY = std::max(tri.minY, tile.startY);
-    int maxX = std::min(tri.maxX, tile.endX-1);
-    int maxY = std::min(tri.maxY, tile.endY - 1);
+// Turns the three vertices into edge functions and attribute planes relative to the
+// bounding box's top-left pixel; tri's bounds must already be set
+void Renderer::SetupTriangle(TriangleData& tri, const ScreenVertex& v0, const ScreenVertex& v1, const ScreenVertex& v2, float area) {
+    const ScreenVertex* v[3] = {&v0, &v1, &v2};
+    float originX = (float)tri.minX;
+    float originY = (float)tri.minY;
+    float sign = area > 0 ? 1.0f : -1.0f;
+    float invArea = 1.0f / area;
+
+    // Edge i is opposite vertex i: EdgeFunction(v[i+1], v[i+2], p)
+    float e[3][3];
+    for (int i = 0; i < 3; i++) {
+        const Vector3S& a = v[(i + 1) % 3]->position;
+        const Vector3S& b = v[(i + 2) % 3]->position;
+        e[i][0] = (originX - a.x) * (b.y - a.y) - (originY - a.y) * (b.x - a.x);
+        e[i][1] = b.y - a.y;
+        e[i][2] = a.x - b.x;
+        for (int k = 0; k < 3; k++) {
+            tri.edge[i][k] = e[i][k] * sign;
+        }
+    }
 
-    const ScreenVertex& v0 = tri.v0;
-    const ScreenVertex& v1 = tri.v1;
-    const ScreenVertex& v2 = tri.v2;
-    
-    float area = tri.area;
-    if (area == 0) return;
+    for (int i = 0; i < 3; i++) {
+        const ScreenVertex& vert = *v[i];
+        float values[AttrCount] = {
+            vert.position.z, vert.invW,
+            vert.worldPos.x, vert.worldPos.y, vert.worldPos.z,
+            vert.normal.x, vert.normal.y, vert.normal.z,
+            vert.uv.x, vert.uv.y,
+            vert.lightIntensity
+        };
+        // Barycentric weight of vertex i is e[i] / area; accumulate each vertex's share
+        float w = e[i][0] * invArea, wx = e[i][1] * invArea, wy = e[i][2] * invArea;
+        for (int k = 0; k < AttrCount; k++) {
+            if (i == 0) {
+                tri.attr[k] = tri.attrDx[k] = tri.attrDy[k] = 0.0f;
+            }
+            tri.attr[k] += values[k] * w;
+            tri.attrDx[k] += values[k] * wx;
+            tri.attrDy[k] += values[k] * wy;
+        }
+    }
+}
 
-    for (int y = minY; y <= maxY; y++) {
-        for (int x = minX; x <= maxX; x++) {
-            Vector3S p = {(float)x, (float)y, 0};
+// Perspective-correct fragment inputs from the screen-linear attribute values at p
+ScreenVertex Renderer::InterpolateVertex(const float* a, const Vector3S& p) {
+    float pixelW = 1.0f / a[AttrInvW];
+    ScreenVertex pixelIn;
+    pixelIn.position = p;
+    pixelIn.invW = a[AttrInvW];
+    // Scaling by w doesn't survive normalization, so it is skipped
+    pixelIn.normal = Vector3Normalize({a[AttrNormalX], a[AttrNormalY], a[AttrNormalZ]});
+    pixelIn.worldPos = {a[AttrWorldX] * pixelW, a[AttrWorldY] * pixelW, a[AttrWorldZ] * pixelW};
+    pixelIn.uv = {a[AttrU] * pixelW, a[AttrV] * pixelW};
+    pixelIn.lightIntensity = a[AttrLight] * pixelW;
+    return pixelIn;
+}
 
-            
-            float w0 = EdgeFunction(v1.position, v2.position, p);
-            float w1 = EdgeFunction(v2.position, v0.position, p);
-            float w2 = EdgeFunction(v0.position, v1.position, p);
+// What span mode interpolates linearly between corrected span ends, in SpanVertex order
+static const int kSpanAttrs[] = {AttrWorldX, AttrWorldY, AttrWorldZ, AttrU, AttrV, AttrLight};
+static const int kSpanAttrCount = 6;
+
+// Fragment inputs from linearly interpolated span values; the rest as InterpolateVertex
+static ScreenVertex SpanVertex(const float* a, const float* values, const Vector3S& p) {
+    ScreenVertex pixelIn;
+    pixelIn.position = p;
+    pixelIn.invW = a[AttrInvW];
+    pixelIn.normal = Vector3Normalize({a[AttrNormalX], a[AttrNormalY], a[AttrNormalZ]});
+    pixelIn.worldPos = {values[0], values[1], values[2]};
+    pixelIn.uv = {values[3], values[4]};
+    pixelIn.lightIntensity = values[5];
+    return pixelIn;
+}
 
-            if ((w0 >= 0 && w1 >= 0 && w2 >= 0) || (w0 <= 0 && w1 <= 0 && w2 <= 0)) {
-                float lambda0 = w0 / area;
-                float lambda1 = w1 / area;
-                float lambda2 = w2 / area;
+// Blends a colour under b, where a is nearer: one fragment standing for both
+static TransparentFragment BlendUnder(const TransparentFragment& a, const TransparentFragment& b) {
+    float nearAlpha = a.color.a / 255.0f;
+    float farAlpha = b.color.a / 255.0f * (1.0f - nearAlpha);
+    float alpha = nearAlpha + farAlpha;
+    float invAlpha = 1.0f / alpha;
+    return {a.depth, {
+        (unsigned char)((a.color.r * nearAlpha + b.color.r * farAlpha) * invAlpha + 0.5f),
+        (unsigned char)((a.color.g * nearAlpha + b.color.g * farAlpha) * invAlpha + 0.5f),
+        (unsigned char)((a.color.b * nearAlpha + b.color.b * farAlpha) * invAlpha + 0.5f),
+        (unsigned char)(alpha * 255.0f + 0.5f)
+    }};
+}
 
-                float z = lambda0 * v0.position.z + lambda1 * v1.position.z + lambda2 * v2.position.z;
+// Adds a blended fragment to a pixel's list, keeping it sorted nearest first. A full list
+// folds its two farthest fragments together, so overflow costs ordering accuracy only
+// among the deepest layers and never drops coverage.
+static void InsertFragment(TileBuffer& tileBuffer, int pixel, float depth, Color color) {
+    if (color.a == 0) return;
+    TransparentFragment* list = &tileBuffer.fragments[pixel * kMaxTransparentLayers];
+    unsigned char& count = tileBuffer.fragmentCounts[pixel];
+    TransparentFragment fragment = {depth, color};
+
+    int n = count;
+    bool full = n == kMaxTransparentLayers;
+    TransparentFragment evicted;
+    if (full) {
+        if (depth >= list[n - 1].depth) {
+            list[n - 1] = BlendUnder(list[n - 1], fragment);
+            return;
+        }
+        evicted = list[--n];
+    }
+    int i = n;
+    for (; i > 0 && list[i - 1].depth > depth; i--) {
+        list[i] = list[i - 1];
+    }
+    list[i] = fragment;
+    n++;
+    if (full) {
+        list[n - 1] = BlendUnder(list[n - 1], evicted);
+    }
+    count = (unsigned char)n;
+}
 
-                int index = y * width + x;
-                if (z < depthBuffer[index]) {
-                    depthBuffer[index] = z;
-                    
-                    float pixelInvW = lambda0 * v0.invW + lambda1 * v1.invW + lambda2 * v2.invW;
-                    float pixelW = 1.0f / pixelInvW;
-                    ScreenVertex pixelIn;
-                    pixelIn.position = p;
-                    pixelIn.normal.x = lambda0 * v0.normal.x + lambda1 * v1.normal.x + lambda2 * v2.normal.x;
-                    pixelIn.normal.y = lambda0 * v0.normal.y + lambda1 * v1.normal.y + lambda2 * v2.normal.y;
-                    pixelIn.normal.z = lambda0 * v0.normal.z + lambda1 * v1.normal.z + lambda2 * v2.normal.z;
-                    pixelIn.normal = Vector3Scale(pixelIn.normal, pixelW);
-    
-                    pixelIn.normal = Vector3Normalize(pixelIn.normal);
+// spanLength 0 divides by w at every pixel. Otherwise the divide happens only at span
+// ends, and only for spans with a shaded pixel. Spans start at screen-space multiples of
+// spanLength, a power of two, clamped to the triangle's bounds: they stay put however
+// the screen is cut into jobs.
+// Blended triangles leave depth alone and add fragments instead of writing colour.
+void Renderer::RasterizeTriangleInTile(const TriangleData& tri, TileBuffer& tileBuffer, const CameraS& cam, int spanLength) {
+    int minX = std::max((int)tri.minX, tileBuffer.startX);
+    int minY = std::max((int)tri.minY, tileBuffer.startY);
+    int maxX = std::min((int)tri.maxX, tileBuffer.startX + tileBuffer.width - 1);
+    int maxY = std::min((int)tri.maxY, tileBuffer.startY + tileBuffer.height - 1);
+    if (minX > maxX || minY > maxY) return;
+    bool blended = tri.alpha != 255;
+    const CpuKernels& kernels = *rasterFrame->kernels;
+    int count = maxX - minX + 1;
+
+    // Each row's planes at the triangle's origin column; along the row, values are taken at
+    // a pixel's offset from that column, as the coverage kernels do
+    int originOffset = minX - tri.minX;
+    float edgeRow[3];
+    float attrRow[AttrCount];
 
-                    pixelIn.worldPos.x = lambda0 * v0.worldPos.x + lambda1 * v1.worldPos.x + lambda2 * v2.worldPos.x;
-                    pixelIn.worldPos.y = lambda0 * v0.worldPos.y + lambda1 * v1.worldPos.y + lambda2 * v2.worldPos.y;
-                    pixelIn.worldPos.z = lambda0 * v0.worldPos.z + lambda1 * v1.worldPos.z + lambda2 * v2.worldPos.z;
-                    pixelIn.worldPos = Vector3Scale(pixelIn.worldPos, pixelW);
+    for (int y = minY; y <= maxY; y++) {
+        float offsetY = (float)(y - tri.minY);
+        for (int i = 0; i < 3; i++) {
+            edgeRow[i] = tri.edge[i][0] + tri.edge[i][2] * offsetY;
+        }
+        for (int k = 0; k < AttrCount; k++) {
+            attrRow[k] = tri.attr[k] + tri.attrDy[k] * offsetY;
+        }
+        int rowIndex = (y - tileBuffer.startY) * tileBuffer.width + (minX - tileBuffer.startX);
+        float* depthRow = &tileBuffer.depth[rowIndex];
+        Color* colorRow = &tileBuffer.color[rowIndex];
+        CoverageRow coverageRow = {
+            {edgeRow[0], edgeRow[1], edgeRow[2]},
+            {tri.edge[0][1], tri.edge[1][1], tri.edge[2][1]},
+            attrRow[AttrDepth], tri.attrDx[AttrDepth],
+            originOffset
+        };
+
+        // Corrected values at x, straight from the plane equations
+        auto correctAt = [&](int x, float* out) {
+            float offset = (float)(x - tri.minX);
+            float invW = attrRow[AttrInvW] + tri.attrDx[AttrInvW] * offset;
+            if (invW <= 0.0f) return false;
+            float w = 1.0f / invW;
+            for (int k = 0; k < kSpanAttrCount; k++) {
+                out[k] = (attrRow[kSpanAttrs[k]] + tri.attrDx[kSpanAttrs[k]] * offset) * w;
+            }
+            return true;
+        };
+        int spanBase = -1, spanStart = 0;
+        bool spanReady = false, spanExact = false;
+        float spanValues[kSpanAttrCount], spanSteps[kSpanAttrCount], endValues[kSpanAttrCount];
+        int endX = -1;    // Where endValues were taken; the next span starts there
+
+        // Covered, depth-passing pixels 64 at a time; only those are interpolated and shaded
+        for (int first = 0; first < count; first += 64) {
+            uint64_t mask = kernels.coverage(coverageRow, depthRow, first, std::min(64, count - first));
+            while (mask) {
+                int offset = first + LowestBit(mask);
+                mask &= mask - 1;
+                int x = minX + offset;
+                float a[AttrCount];
+                float offsetX = (float)(originOffset + offset);
+                for (int k = 0; k < AttrCount; k++) {
+                    a[k] = attrRow[k] + tri.attrDx[k] * offsetX;
+                }
+                if (!blended) depthRow[offset] = a[AttrDepth];
+
+                ScreenVertex pixelIn;
+                if (spanLength == 0) {
+                    pixelIn = InterpolateVertex(a, {(float)x, (float)y, 0});
+                } else {
+                    int base = x & ~(spanLength - 1);
+                    if (base != spanBase) {
+                        spanBase = base;
+                        spanReady = false;
+                    }
+                    if (!spanReady) {
+                        spanStart = std::max(base, (int)tri.minX);
+                        int spanEnd = std::min(base + spanLength, (int)tri.maxX);
+                        bool valid;
+                        if (endX == spanStart) {
+                            std::copy(endValues, endValues + kSpanAttrCount, spanValues);
+                            valid = true;
+                        } else {
+                            valid = correctAt(spanStart, spanValues);
+                        }
+                        valid = valid && correctAt(spanEnd, endValues);
+                        endX = valid ? spanEnd : -1;
+                        float invLength = spanEnd > spanStart ? 1.0f / (float)(spanEnd - spanStart) : 0.0f;
+                        for (int k = 0; valid && k < kSpanAttrCount; k++) {
+                            spanSteps[k] = (endValues[k] - spanValues[k]) * invLength;
+                        }
+                        spanExact = !valid;    // An end behind the camera; divide per pixel
+                        spanReady = true;
+                    }
+                    if (spanExact) {
+                        pixelIn = InterpolateVertex(a, {(float)x, (float)y, 0});
+                    } else {
+                        float t = (float)(x - spanStart);
+                        float values[kSpanAttrCount];
+                        for (int k = 0; k < kSpanAttrCount; k++) {
+                            values[k] = spanValues[k] + spanSteps[k] * t;
+                        }
+                        pixelIn = SpanVertex(a, values, {(float)x, (float)y, 0});
+                    }
+                }
+                Color color = FragmentShader(pixelIn, cam, tri.texture, tri);
+                if (blended) {
+                    InsertFragment(tileBuffer, rowIndex + offset, a[AttrDepth], color);
+                } else {
+                    colorRow[offset] = color;
+                }
+            }
+        }
+    }
+}
 
-                    pixelIn.uv.x = (lambda0 * v0.uv.x + lambda1 * v1.uv.x + lambda2 * v2.uv.x) * pixelW;
-                    pixelIn.uv.y = (lambda0 * v0.uv.y + lambda1 * v1.uv.y + lambda2 * v2.uv.y) * pixelW;
+// 4x rotated-grid MSAA: coverage and depth per sample, FragmentShader once per
+// pixel at the centroid of the covered samples, colour stored to the samples that pass.
+// Blended triangles add one fragment per pixel, its alpha scaled by the samples passed.
+void Renderer::RasterizeTriangleInTileMSAA(const TriangleData& tri, TileBuffer& tileBuffer, const CameraS& cam) {
+    static const float sampleOffsets[kMSAASamples][2] = {
+        {-0.125f, -0.375f}, {0.375f, -0.125f}, {0.125f, 0.375f}, {-0.375f, 0.125f}
+    };
 
-                    // Interpolate light intensity for Gouraud shading
-                    pixelIn.lightIntensity = (lambda0 * v0.lightIntensity + lambda1 * v1.lightIntensity + lambda2 * v2.lightIntensity) * pixelW;
+    int minX = std::max((int)tri.minX, tileBuffer.startX);
+    int minY = std::max((int)tri.minY, tileBuffer.startY);
+    int maxX = std::min((int)tri.maxX, tileBuffer.startX + tileBuffer.width - 1);
+    int maxY = std::min((int)tri.maxY, tileBuffer.startY + tileBuffer.height - 1);
+    if (minX > maxX || minY > maxY) return;
+    bool blended = tri.alpha != 255;
+
+    // Per-sample offsets of each edge and of depth, constant for the triangle
+    float edgeSample[3][kMSAASamples];
+    float depthSample[kMSAASamples];
+    for (int s = 0; s < kMSAASamples; s++) {
+        for (int i = 0; i < 3; i++) {
+            edgeSample[i][s] = tri.edge[i][1] * sampleOffsets[s][0] + tri.edge[i][2] * sampleOffsets[s][1];
+        }
+        depthSample[s] = tri.attrDx[AttrDepth] * sampleOffsets[s][0] + tri.attrDy[AttrDepth] * sampleOffsets[s][1];
+    }
 
-                    Color finalColor = FragmentShader(pixelIn, cam, tri.texture, tri);
-                    PutPixel(x, y, finalColor);
+    // Planes at each pixel's offset from the triangle's origin, as in the single-sample loop
+    float edgeRow[3];
+    float attrRow[AttrCount];
+    for (int y = minY; y <= maxY; y++) {
+        float offsetY = (float)(y - tri.minY);
+        for (int i = 0; i < 3; i++) {
+            edgeRow[i] = tri.edge[i][0] + tri.edge[i][2] * offsetY;
+        }
+        for (int k = 0; k < AttrCount; k++) {
+            attrRow[k] = tri.attr[k] + tri.attrDy[k] * offsetY;
+        }
+
+        for (int x = minX; x <= maxX; x++) {
+            int index = ((y - tileBuffer.startY) * tileBuffer.width + (x - tileBuffer.startX)) * kMSAASamples;
+            float offsetX = (float)(x - tri.minX);
+            float w0 = edgeRow[0] + tri.edge[0][1] * offsetX;
+            float w1 = edgeRow[1] + tri.edge[1][1] * offsetX;
+            float w2 = edgeRow[2] + tri.edge[2][1] * offsetX;
+            float depth = attrRow[AttrDepth] + tri.attrDx[AttrDepth] * offsetX;
+
+            float sumX = 0.0f, sumY = 0.0f;
+            int writeMask = 0;
+            int covered = 0;
+
+            for (int s = 0; s < kMSAASamples; s++) {
+                if (w0 + edgeSample[0][s] < 0 || w1 + edgeSample[1][s] < 0 || w2 + edgeSample[2][s] < 0) continue;
+
+                sumX += sampleOffsets[s][0];
+                sumY += sampleOffsets[s][1];
+                covered++;
+
+                float z = depth + depthSample[s];
+                if (z < tileBuffer.depth[index + s]) {
+                    if (!blended) tileBuffer.depth[index + s] = z;
+                    writeMask |= 1 << s;
+                }
+            }
+
+            if (writeMask != 0) {
+                // Attributes are linear, so the mean of the covered samples' values is
+                // the value at their mean position
+                float invCovered = 1.0f / covered;
+                float cx = sumX * invCovered, cy = sumY * invCovered;
+                float centroid[AttrCount];
+                for (int k = 0; k < AttrCount; k++) {
+                    float a = attrRow[k] + tri.attrDx[k] * offsetX;
+                    centroid[k] = a + tri.attrDx[k] * cx + tri.attrDy[k] * cy;
+                }
+                ScreenVertex pixelIn = InterpolateVertex(centroid, {(float)x, (float)y, 0});
+                Color color = FragmentShader(pixelIn, cam, tri.texture, tri);
+
+                if (blended) {
+                    int passed = 0;
+                    for (int s = 0; s < kMSAASamples; s++) passed += (writeMask >> s) & 1;
+                    color.a = (unsigned char)((color.a * passed + kMSAASamples / 2) / kMSAASamples);
+                    InsertFragment(tileBuffer, index / kMSAASamples, centroid[AttrDepth], color);
+                } else {
+                    for (int s = 0; s < kMSAASamples; s++) {
+                        if (writeMask & (1 << s)) tileBuffer.color[index + s] = color;
+                    }
                 }
             }
         }
     }
 }
 
-void Renderer::RasterizeTile(int tileIndex, const CameraS& cam) {
-    const Tile& tile = tiles[tileIndex];
+void Renderer::ClearTileRect(const TileJob& job, Color color) {
+    const CpuKernels& kernels = *rasterFrame->kernels;
+    for (int y = job.startY; y < job.endY; y++) {
+        kernels.fillColor(pixelBuffer + y * width + job.startX, job.endX - job.startX, color);
+    }
+}
+
+// Writes the tile's pixels to target, its top-left pixel, with rows stride pixels apart
+void Renderer::ResolveTile(const TileBuffer& tileBuffer, Color* target, int stride) {
+    if (tileBuffer.samples == 1) {
+        for (int ly = 0; ly < tileBuffer.height; ly++) {
+            const Color* src = tileBuffer.color.data() + ly * tileBuffer.width;
+            std::copy(src, src + tileBuffer.width, target + ly * stride);
+        }
+        return;
+    }
 
-    for (int triIdx : tile.triangleIndices) {
-        RasterizeTriangleInTile(triangleBuffer[triIdx], tile, cam);
+    // Box-filter the samples of each pixel
+    static_assert(kMSAASamples == 4, "Resolve kernels average 4 samples");
+    const CpuKernels& kernels = *rasterFrame->kernels;
+    for (int ly = 0; ly < tileBuffer.height; ly++) {
+        const Color* src = tileBuffer.color.data() + ly * tileBuffer.width * tileBuffer.samples;
+        kernels.resolve4x(src, target + ly * stride, tileBuffer.width);
     }
 }
 
-VSOutput Renderer::VertexShader(const Vertex& vertex, const Matrix4x4&mvp, const Matrix4x4& worldMat, const Matrix4x4& normalMat, const CameraS& cam) {
+// Blends each pixel's fragments over its resolved colour in target, farthest first
+void Renderer::CompositeFragments(const TileBuffer& tileBuffer, Color* target, int stride) {
+    for (int ly = 0; ly < tileBuffer.height; ly++) {
+        Color* dst = target + ly * stride;
+        for (int lx = 0; lx < tileBuffer.width; lx++) {
+            int pixel = ly * tileBuffer.width + lx;
+            int count = tileBuffer.fragmentCounts[pixel];
+            if (count == 0) continue;
+            const TransparentFragment* list = &tileBuffer.fragments[pixel * kMaxTransparentLayers];
+            float r = dst[lx].r, g = dst[lx].g, b = dst[lx].b, a = dst[lx].a;
+            for (int i = count - 1; i >= 0; i--) {
+                const Color& c = list[i].color;
+                float alpha = c.a / 255.0f;
+                r = c.r * alpha + r * (1.0f - alpha);
+                g = c.g * alpha + g * (1.0f - alpha);
+                b = c.b * alpha + b * (1.0f - alpha);
+                a = c.a + a * (1.0f - alpha);
+            }
+            dst[lx] = {(unsigned char)(r + 0.5f), (unsigned char)(g + 0.5f), (unsigned char)(b + 0.5f), (unsigned char)(a + 0.5f)};
+        }
+    }
+}
+
+void Renderer::RasterizeTile(const TileJob& job) {
+    const FrameContext& frame = *rasterFrame;
+    const Tile& tile = frame.tiles[job.tileIndex];
+    bool post = !frame.post.IsEmpty();
+
+    if (tile.triangleCount == 0 && !post) {
+        ClearTileRect(job, frame.clearColor);
+        return;
+    }
+
+    // One per worker, reused across jobs; at 64x64 it stays resident in L1/L2. With a post
+    // chain it also covers the chain's halo, so neighbourhood filters see real neighbours.
+    static thread_local TileBuffer tileBuffer;
+    int halo = post ? frame.postHalo : 0;
+    tileBuffer.startX = std::max(0, job.startX - halo);
+    tileBuffer.startY = std::max(0, job.startY - halo);
+    tileBuffer.width = std::min(frame.width, job.endX + halo) - tileBuffer.startX;
+    tileBuffer.height = std::min(frame.height, job.endY + halo) - tileBuffer.startY;
+    tileBuffer.samples = frame.antiAliasing == AntiAliasing::MSAA4x ? kMSAASamples : 1;
+
+    size_t sampleCount = (size_t)tileBuffer.width * tileBuffer.height * tileBuffer.samples;
+    tileBuffer.color.resize(sampleCount);
+    tileBuffer.depth.resize(sampleCount);
+    frame.kernels->fillColor(tileBuffer.color.data(), sampleCount, frame.clearColor);
+    frame.kernels->fillDepth(tileBuffer.depth.data(), sampleCount, std::numeric_limits<float>::max());
+    int spanLength = frame.perspectiveCorrection == PerspectiveCorrection::Span8 ? 8 :
+                     frame.perspectiveCorrection == PerspectiveCorrection::Span16 ? 16 : 0;
+
+    auto rasterize = [&](const TriangleData& tri) {
+        if (tileBuffer.samples == 1) {
+            RasterizeTriangleInTile(tri, tileBuffer, frame.views[tri.viewIndex].camera, spanLength);
+        } else {
+            RasterizeTriangleInTileMSAA(tri, tileBuffer, frame.views[tri.viewIndex].camera);
+        }
+    };
+    // Opaque triangles first, so blended ones are depth-tested against the final surface
+    // and their fragments never include anything an opaque triangle hides later
+    ForEachTileTriangle(frame, job.tileIndex, [&](const TriangleData& tri) {
+        if (tri.alpha == 255) rasterize(tri);
+    });
+    bool blended = tile.transparentCount > 0;
+    if (blended) {
+        size_t pixelCount = (size_t)tileBuffer.width * tileBuffer.height;
+        tileBuffer.fragmentCounts.assign(pixelCount, 0);
+        if (tileBuffer.fragments.size() < pixelCount * kMaxTransparentLayers) {
+            tileBuffer.fragments.resize(pixelCount * kMaxTransparentLayers);
+        }
+        ForEachTileTriangle(frame, job.tileIndex, [&](const TriangleData& tri) {
+            if (tri.alpha != 255) rasterize(tri);
+        });
+    }
+
+    if (post) {
+        PostProcessTile(frame, tileBuffer, job);
+        return;
+    }
+    Color* target = pixelBuffer + tileBuffer.startY * width + tileBuffer.startX;
+    ResolveTile(tileBuffer, target, width);
+    if (blended) CompositeFragments(tileBuffer, target, width);
+}
+
+// Resolves the tile and its halo into scratch, runs the post chain over it while it is
+// still in cache, and writes out only the job's own pixels
+void Renderer::PostProcessTile(const FrameContext& frame, TileBuffer& tileBuffer, const TileJob& job) {
+    int pixelCount = tileBuffer.width * tileBuffer.height;
+    tileBuffer.resolved.resize(pixelCount);
+    ResolveTile(tileBuffer, tileBuffer.resolved.data(), tileBuffer.width);
+    if (frame.tiles[job.tileIndex].transparentCount > 0) {
+        CompositeFragments(tileBuffer, tileBuffer.resolved.data(), tileBuffer.width);
+    }
+
+    tileBuffer.postColor.resize((size_t)pixelCount * 3);
+    float* rgb = tileBuffer.postColor.data();
+    for (int p = 0; p < pixelCount; p++) {
+        const Color& c = tileBuffer.resolved[p];
+        rgb[p * 3] = c.r * (1.0f / 255.0f);
+        rgb[p * 3 + 1] = c.g * (1.0f / 255.0f);
+        rgb[p * 3 + 2] = c.b * (1.0f / 255.0f);
+    }
+
+    const float* viewDepth = nullptr;
+    if (frame.post.UsesDepth()) {
+        // Nearest sample, back from NDC depth to distance along the view axis
+        tileBuffer.postDepth.resize(pixelCount);
+        for (int p = 0; p < pixelCount; p++) {
+            const float* samples = &tileBuffer.depth[(size_t)p * tileBuffer.samples];
+            float z = *std::min_element(samples, samples + tileBuffer.samples);
+            tileBuffer.postDepth[p] = z == std::numeric_limits<float>::max() ? std::numeric_limits<float>::infinity() :
+                kNearPlane / std::max(1e-7f, 1.0f - z * (kFarPlane - kNearPlane) / kFarPlane);
+        }
+        viewDepth = tileBuffer.postDepth.data();
+    }
+
+    PostTile postTile = {tileBuffer.startX, tileBuffer.startY, tileBuffer.width, tileBuffer.height, rgb, viewDepth,
+                         frame.width, frame.height};
+    ApplyPostChain(frame.post, postTile, tileBuffer.postScratch);
+
+    for (int y = job.startY; y < job.endY; y++) {
+        int p = (y - tileBuffer.startY) * tileBuffer.width + (job.startX - tileBuffer.startX);
+        Color* dst = pixelBuffer + y * width;
+        for (int x = job.startX; x < job.endX; x++, p++) {
+            dst[x] = {
+                (unsigned char)(std::max(0.0f, std::min(1.0f, rgb[p * 3])) * 255.0f + 0.5f),
+                (unsigned char)(std::max(0.0f, std::min(1.0f, rgb[p * 3 + 1])) * 255.0f + 0.5f),
+                (unsigned char)(std::max(0.0f, std::min(1.0f, rgb[p * 3 + 2])) * 255.0f + 0.5f),
+                tileBuffer.resolved[p].a
+            };
+        }
+    }
+}
+
+// World-space part of the vertex stage; clip-space position is filled in per view
+VSOutput Renderer::VertexShader(const Vertex& vertex, const Matrix4x4& worldMat, const Matrix4x4& normalMat) {
     VSOutput out;
-    out.position = MultiplyVectorMatrix4(vertex.position, mvp);
+    out.position = {0, 0, 0, 1};
 
     out.worldPos = MultiplyVectorMatrix(vertex.position, worldMat);
     out.normal = Vector3Normalize(MultiplyVectorDirection(vertex.normal, normalMat));
@@ -250,11 +1612,11 @@ VSOutput Renderer::VertexShader(const Vertex& vertex, const Matrix4x4&mvp, const
     return out;
 }
 
-ScreenVertex Renderer::PerspectiveDivide(const VSOutput& in) {
+ScreenVertex Renderer::PerspectiveDivide(const VSOutput& in, float viewX, float viewY, float viewWidth, float viewHeight) {
     ScreenVertex out;
     out.invW = 1.0f/in.position.w;
-    out.position.x = (in.position.x * out.invW + 1.0f) * 0.5f * width;
-    out.position.y = (in.position.y * out.invW  + 1.0f) * 0.5f * height;
+    out.position.x = viewX + (in.position.x * out.invW + 1.0f) * 0.5f * viewWidth;
+    out.position.y = viewY + (in.position.y * out.invW  + 1.0f) * 0.5f * viewHeight;
     out.position.z = in.position.z * out.invW;
 
     out.worldPos = Vector3Scale(in.worldPos, out.invW );
@@ -267,60 +1629,129 @@ ScreenVertex Renderer::PerspectiveDivide(const VSOutput& in) {
     return out;
 };
 
-float Renderer::ComputeLightIntensity(const Vector3S& normal, const Vector3S& worldPos, const CameraS& cam) {
-    Vector3S lightDir = {0.5f, 0.4f, 1.0f};
-    lightDir = Vector3Normalize(lightDir);
+// Direction light travels at worldPos, and how much of it arrives (spot cone falloff)
+Vector3S Renderer::LightDirectionAt(const LightS& light, const Vector3S& worldPos, float& attenuation) const {
+    Vector3S axis = Vector3Normalize(light.direction);
+    attenuation = light.intensity;
+    if (light.type == LightType::Directional) return axis;
+
+    Vector3S dir = Vector3Normalize(Vector3Sub(worldPos, light.position));
+    float cosOuter = cosf(light.spotAngle);
+    float cosInner = cosf(light.spotAngle * 0.8f);
+    float cone = (Vector3Dot(dir, axis) - cosOuter) / std::max(1e-4f, cosInner - cosOuter);
+    attenuation *= std::max(0.0f, std::min(1.0f, cone));
+    return dir;
+}
+
+// Average shadow-map visibility over the shadow-casting lights
+float Renderer::ShadowVisibility(const FrameContext& frame, const Vector3S& worldPos) const {
+    float visibility = 0.0f;
+    int count = 0;
+    for (size_t i = 0; i < frame.shadowMaps.size(); i++) {
+        if (!frame.shadowMaps[i].valid) continue;
+        visibility += frame.shadowMaps[i].Visibility(worldPos, frame.shadowQuality);
+        count++;
+    }
+    return count ? visibility / count : 1.0f;
+}
+
+// shadowed is false while recording (Gouraud/flat run before the shadow pass)
+float Renderer::ComputeLightIntensity(const FrameContext& frame, const Vector3S& normal, const Vector3S& worldPos, const CameraS& cam, bool shadowed) {
     Vector3S viewDir = Vector3Normalize(Vector3Sub(cam.position, worldPos));
 
     float ambient = 0.1f;
-    float diff = std::max(0.0f, Vector3Dot(normal, Vector3Scale(lightDir, -1.0f)));
-    
-    // Specular (Blinn-Phong style)
-    Vector3S refl = Vector3Sub(lightDir, Vector3Scale(Vector3Scale(normal, Vector3Dot(normal, lightDir)), 2));
-    float specularity = powf(std::max(0.0f, Vector3Dot(viewDir, refl)), 16);
+    float lit = 0.0f;
+    for (size_t i = 0; i < frame.lights.size(); i++) {
+        float attenuation;
+        Vector3S lightDir = LightDirectionAt(frame.lights[i], worldPos, attenuation);
+        if (attenuation <= 0.0f) continue;
+        if (shadowed && i < frame.shadowMaps.size() && frame.shadowMaps[i].valid) {
+            attenuation *= frame.shadowMaps[i].Visibility(worldPos, frame.shadowQuality);
+            if (attenuation <= 0.0f) continue;
+        }
+
+        float diff = std::max(0.0f, Vector3Dot(normal, Vector3Scale(lightDir, -1.0f)));
+        
+        // Specular (Blinn-Phong style)
+        Vector3S refl = Vector3Sub(lightDir, Vector3Scale(Vector3Scale(normal, Vector3Dot(normal, lightDir)), 2));
+        float specularity = powf(std::max(0.0f, Vector3Dot(viewDir, refl)), 16);
 
-    return std::min(1.0f, ambient + diff * 0.5f + specularity * 0.5f);
+        lit += (diff * 0.5f + specularity * 0.5f) * attenuation;
+    }
+
+    return std::min(1.0f, ambient + lit);
 }
 
-float Renderer::ComputeDiffuseOnly(const Vector3S& normal) {
-    Vector3S lightDir = {0.5f, 0.4f, 1.0f};
-    lightDir = Vector3Normalize(lightDir);
-    
+float Renderer::ComputeDiffuseOnly(const FrameContext& frame, const Vector3S& normal, const Vector3S& worldPos, bool shadowed) {
     float ambient = 0.15f;
-    float diff = std::max(0.0f, Vector3Dot(normal, Vector3Scale(lightDir, -1.0f)));
+    float lit = 0.0f;
+    for (size_t i = 0; i < frame.lights.size(); i++) {
+        float attenuation;
+        Vector3S lightDir = LightDirectionAt(frame.lights[i], worldPos, attenuation);
+        if (shadowed && i < frame.shadowMaps.size() && frame.shadowMaps[i].valid) {
+            attenuation *= frame.shadowMaps[i].Visibility(worldPos, frame.shadowQuality);
+        }
+        float diff = std::max(0.0f, Vector3Dot(normal, Vector3Scale(lightDir, -1.0f)));
+        lit += diff * 0.85f * attenuation;
+    }
     
-    return std::min(1.0f, ambient + diff * 0.85f);
+    return std::min(1.0f, ambient + lit);
+}
+
+// log2 of mip-0 texels per pixel: the larger screen-space UV derivative, taken from
+// the triangle's u/w, v/w and 1/w planes at this pixel
+static float TextureLod(const ScreenVertex& in, const TriangleData& tri, int width, int height) {
+    float w = 1.0f / in.invW;
+    float dudx = (tri.attrDx[AttrU] - in.uv.x * tri.attrDx[AttrInvW]) * w * width;
+    float dvdx = (tri.attrDx[AttrV] - in.uv.y * tri.attrDx[AttrInvW]) * w * height;
+    float dudy = (tri.attrDy[AttrU] - in.uv.x * tri.attrDy[AttrInvW]) * w * width;
+    float dvdy = (tri.attrDy[AttrV] - in.uv.y * tri.attrDy[AttrInvW]) * w * height;
+    float rho2 = std::max(dudx * dudx + dvdx * dvdx, dudy * dudy + dvdy * dvdy);
+    return 0.5f * log2f(std::max(rho2, 1e-12f));
 }
 
 Color Renderer::FragmentShader(const ScreenVertex& in, const CameraS& cam, const TextureS* texture, const TriangleData& tri) {
     // Get base object color from texture or default white
     Color objectColor;
-    if (texture && texture->pixels) {
-        objectColor = texture->SampleBilinear(in.uv.x, in.uv.y);
+    if (texture && texture->virtualTexture) {
+        const VirtualTexture& virtualTexture = *texture->virtualTexture;
+        float lod = TextureLod(in, tri, virtualTexture.GetWidth(), virtualTexture.GetHeight());
+        objectColor = virtualTexture.Sample(in.uv.x, in.uv.y, lod, rasterFrame->kernels->bilinear);
+    } else if (texture && texture->HasData()) {
+        objectColor = texture->SampleBilinear(in.uv.x, in.uv.y, rasterFrame->kernels->bilinear);
     } else {
         objectColor = WHITE;
     }
+    unsigned char alpha = tri.alpha;    // Material opacity
 
+    const FrameContext& frame = *rasterFrame;
     float intensity = 1.0f;
 
-    switch (currentShadingMode) {
+    switch (frame.shadingMode) {
         case ShadingMode::Unlit:
             // No lighting calculation, just return the texture color
-            return objectColor;
+            return {objectColor.r, objectColor.g, objectColor.b, alpha};
 
         case ShadingMode::Flat:
-            // Use pre-computed flat intensity for entire triangle
+            // Use pre-computed flat intensity for entire triangle; shadows darken
+            // everything above ambient, per pixel
             intensity = tri.flatIntensity;
+            if (frame.shadowQuality != ShadowQuality::Off) {
+                intensity = 0.1f + (intensity - 0.1f) * ShadowVisibility(frame, in.worldPos);
+            }
             break;
 
         case ShadingMode::Gouraud:
             // Use interpolated light intensity from vertices
             intensity = in.lightIntensity;
+            if (frame.shadowQuality != ShadowQuality::Off) {
+                intensity = 0.1f + (intensity - 0.1f) * ShadowVisibility(frame, in.worldPos);
+            }
             break;
 
         case ShadingMode::Cel: {
             // Compute per-pixel diffuse intensity (no specular) then quantize to bands
-            float rawIntensity = ComputeDiffuseOnly(in.normal);
+            float rawIntensity = ComputeDiffuseOnly(frame, in.normal, in.worldPos, true);
             
             // Quantize to 4 bands for toon effect
             if (rawIntensity > 0.8f) intensity = 1.0f;
@@ -333,7 +1764,7 @@ Color Renderer::FragmentShader(const ScreenVertex& in, const CameraS& cam, const
         case ShadingMode::Phong:
         default:
             // Full per-pixel Phong lighting
-            intensity = ComputeLightIntensity(in.normal, in.worldPos, cam);
+            intensity = ComputeLightIntensity(frame, in.normal, in.worldPos, cam, true);
             break;
     }
 
@@ -344,7 +1775,7 @@ Color Renderer::FragmentShader(const ScreenVertex& in, const CameraS& cam, const
         (unsigned char)(objectColor.r * intensity),
         (unsigned char)(objectColor.g * intensity),
         (unsigned char)(objectColor.b * intensity),
-        255
+        alpha
     };
 }
 
@@ -381,12 +1812,12 @@ VSOutput Renderer::LerpVSOutput(const VSOutput& a, const VSOutput& b, float t) {
     return out;
 }
 
-std::vector<VSOutput> Renderer::ClipPolygonAgainstPlane(const std::vector<VSOutput>& polygon, int planeIndex) {
-    std::vector<VSOutput> output;
+int Renderer::ClipPolygonAgainstPlane(const VSOutput* polygon, int count, int planeIndex, VSOutput* out) {
+    int outCount = 0;
 
-    for (size_t i = 0; i < polygon.size(); i++) {
+    for (int i = 0; i < count; i++) {
         const VSOutput& current = polygon[i];
-        const VSOutput& next = polygon[(i+1) % polygon.size()];
+        const VSOutput& next = polygon[(i+1) % count];
 
         float currentDist = GetPlaneDistance(current.position, planeIndex);
         float nextDist = GetPlaneDistance(next.position, planeIndex);
@@ -395,133 +1826,451 @@ std::vector<VSOutput> Renderer::ClipPolygonAgainstPlane(const std::vector<VSOutp
         bool nextInside = nextDist >= 0;
 
         if (currentInside) {
-            output.push_back(current);
+            out[outCount++] = current;
 
             if (!nextInside) {
                 float t = currentDist / (currentDist - nextDist);
-                output.push_back(LerpVSOutput(current, next, t));
+                out[outCount++] = LerpVSOutput(current, next, t);
             }
         } else if (nextInside) {
             float t = currentDist / (currentDist - nextDist);
-            output.push_back(LerpVSOutput(current, next, t));
+            out[outCount++] = LerpVSOutput(current, next, t);
         }
     }
 
-    return output;
+    return outCount;
 }
 
-std::vector<VSOutput> Renderer::ClipTriangleAgainstFrustum(const VSOutput& v0, const VSOutput& v1, const VSOutput& v2) {
-    std::vector<VSOutput> polygon = {v0, v1, v2};
-    for (int plane = 0; plane < 6; plane++) {
-        polygon = ClipPolygonAgainstPlane(polygon, plane);
-        if (polygon.empty()) break;
+// Writes the clipped polygon to out, which needs room for kMaxClippedVertices
+int Renderer::ClipTriangleAgainstFrustum(const VSOutput& v0, const VSOutput& v1, const VSOutput& v2, VSOutput* out) {
+    VSOutput scratch[kMaxClippedVertices];
+    out[0] = v0;
+    out[1] = v1;
+    out[2] = v2;
+    int count = 3;
+    for (int plane = 0; plane < 6 && count > 0; plane++) {
+        count = ClipPolygonAgainstPlane(out, count, plane, scratch);
+        std::copy(scratch, scratch + count, out);
     }
-    return polygon;
+    return count;
 }
 
 void Renderer::DrawMesh(const GameObject& obj, const CameraS& cam) {
-    Matrix4x4 matScale = MatrixMakeScale(obj.transform.scale.x, obj.transform.scale.y, obj.transform.scale.z);
-    Matrix4x4 matRotZ = MatrixMakeRotationZ(obj.transform.rotation.z);
-    Matrix4x4 matRotY = MatrixMakeRotationY(obj.transform.rotation.y);
-    Matrix4x4 matRotX = MatrixMakeRotationX(obj.transform.rotation.x);
-    Matrix4x4 matTrans = MatrixMakeTranslation(obj.transform.position.x, obj.transform.position.y, obj.transform.position.z);
+    ViewS view;
+    view.camera = cam;
+    view.width = width;
+    view.height = height;
+    DrawMeshViews(obj, &view, 1);
+}
 
-    Matrix4x4 matWorld = matScale;
-    matWorld = MultiplyMatrix(matWorld, matRotZ);
-    matWorld = MultiplyMatrix(matWorld, matRotX);
-    matWorld = MultiplyMatrix(matWorld, matRotY);
-    matWorld = MultiplyMatrix(matWorld, matTrans);
+void Renderer::DrawMeshMultiView(const GameObject& obj, const std::vector<ViewS>& views) {
+    DrawMeshViews(obj, views.data(), static_cast<int>(views.size()));
+}
 
-    Matrix4x4 matNormal = MatrixInverseTranspose3x3(matWorld);
+// Slot of the view/projection pair for this view, building it if no slot holds it
+int Renderer::CacheView(const ViewS& view) {
+    for (int slot = 0; slot < kCachedViews; slot++) {
+        const CachedView& cached = viewCache[slot];
+        if (cached.version != 0 && cached.width == view.width && cached.height == view.height &&
+            memcmp(&cached.camera, &view.camera, sizeof(CameraS)) == 0) {
+            return slot;
+        }
+    }
 
-    Matrix4x4 matView = MatrixMakeTranslation(-cam.position.x, -cam.position.y, -cam.position.z);
-    matView = MultiplyMatrix(matView, MatrixTranspose(cam.rotationMatrix));
-    Matrix4x4 matProj = MatrixMakeProjection(cam.fov, (float)height / (float)width, 0.1f, 1000.0f);
+    int slot = nextViewSlot;
+    nextViewSlot = (nextViewSlot + 1) % kCachedViews;
+    CachedView& cached = viewCache[slot];
+    const CameraS& cam = view.camera;
+    cached.camera = cam;
+    cached.width = view.width;
+    cached.height = view.height;
+    cached.view = MultiplyMatrix(MatrixMakeTranslation(-cam.position.x, -cam.position.y, -cam.position.z),
+                                 MatrixTranspose(cam.rotationMatrix));
+    cached.proj = MatrixMakeProjection(cam.fov, (float)view.height / (float)view.width, kNearPlane, kFarPlane);
+    cached.version = nextViewVersion++;
+    return slot;
+}
 
-    Matrix4x4 matMVP = Matrix4x4::Identity();
-    matMVP = MultiplyMatrix(matWorld, matView);
-    matMVP = MultiplyMatrix(matMVP, matProj);
+void Renderer::DrawMeshViews(const GameObject& obj, const ViewS* views, int viewCount) {
+    FrameContext& frame = frames[recordFrame];
+    // Resolved once here, so the whole frame uses one version of the asset
+    const MeshS* mesh = obj.mesh.Get();
+    if (!mesh) return;
+
+    // One batched update covers every object changed since the last draw
+    TransformSystem& transforms = obj.transform.GetSystem();
+    uint32_t id = obj.transform.GetId();
+    if (transforms.HasChanges()) transforms.Update();
+
+    uint8_t alpha = (uint8_t)std::lround(std::max(0.0f, std::min(1.0f, obj.opacity)) * 255.0f);
+    DrawRecord draw = {&obj, mesh, mesh->indices.size(), obj.texture.Get(), alpha, transforms.GetWorld(id),
+                       transforms.GetNormal(id), INT_MAX, INT_MAX, INT_MIN, INT_MIN, (int)frame.views.size(), 0, false};
+    for (int i = 0; i < viewCount; i++) {
+        if (views[i].width <= 0 || views[i].height <= 0) continue;
+        int slot = CacheView(views[i]);
+        const CachedView& cached = viewCache[slot];
+        frame.views.push_back(views[i]);
+        frame.viewMVPs.push_back(transforms.GetMVP(id, slot, cached.version, cached.view, cached.proj));
+        draw.viewCount++;
+    }
+    CaptureDeformation(frame, draw, obj);
+    frame.draws.push_back(draw);
+
+    if (!frame.deferGeometry) {
+        int drawIndex = (int)frame.draws.size() - 1;
+        if (draw.deformedOffset >= 0) {
+            // Workers may still be rasterizing the previous frame: deform on this thread
+            RunDeformJob(frame, {drawIndex, 0, (uint32_t)mesh->vertices.size()});
+            frame.draws[drawIndex].deformed = true;
+        }
+        ProcessDraw(frame, frame.binSlots[0], drawIndex);
+    }
+}
+
+// Snapshots the object's pose into the frame and reserves its deformed vertices.
+// Objects in bind pose with no active morph target draw the mesh as it is.
+void Renderer::CaptureDeformation(FrameContext& frame, DrawRecord& draw, const GameObject& obj) {
+    const MeshS& mesh = *draw.mesh;
+    bool skinned = mesh.skin.size() == mesh.vertices.size() && !mesh.inverseBindMatrices.empty() &&
+                   !obj.jointTransforms.empty();
+    int morphCount = (int)std::min(mesh.morphTargets.size(), obj.morphWeights.size());
+    bool morphed = false;
+    for (int t = 0; t < morphCount; t++) {
+        morphed = morphed || obj.morphWeights[t] != 0.0f;
+    }
+    if (!skinned && !morphed) return;
+
+    if (skinned) {
+        draw.paletteOffset = (int)frame.jointPalettes.size();
+        draw.jointCount = (int)mesh.inverseBindMatrices.size();
+        for (int j = 0; j < draw.jointCount; j++) {
+            // Joints the pose leaves out stay where they were bound
+            frame.jointPalettes.push_back(j < (int)obj.jointTransforms.size() ?
+                MultiplyMatrix(mesh.inverseBindMatrices[j], obj.jointTransforms[j]) : Matrix4x4::Identity());
+        }
+    }
+    if (morphed) {
+        draw.morphOffset = (int)frame.morphWeights.size();
+        draw.morphCount = morphCount;
+        frame.morphWeights.insert(frame.morphWeights.end(), obj.morphWeights.begin(), obj.morphWeights.begin() + morphCount);
+    }
+    draw.deformedOffset = (int)frame.deformedVertices.size();
+    frame.deformedVertices.resize(frame.deformedVertices.size() + mesh.vertices.size());
+}
 
-    ClearTiles();
+void Renderer::RunDeformJob(FrameContext& frame, const DeformJob& job) {
+    const DrawRecord& draw = frame.draws[job.drawIndex];
+    DeformVertices(*draw.mesh, draw.jointCount ? &frame.jointPalettes[draw.paletteOffset] : nullptr,
+                   draw.morphCount ? &frame.morphWeights[draw.morphOffset] : nullptr, draw.morphCount,
+                   job.begin, job.end, &frame.deformedVertices[draw.deformedOffset + job.begin]);
+}
 
-    std::vector<VSOutput> processedVertices;
-    for (const auto& v : obj.mesh.vertices) {
-        processedVertices.push_back(VertexShader(v, matMVP, matWorld, matNormal, cam));
+// Skins and morphs every deferred draw in fixed-size vertex batches spread over the
+// workers, so one detailed character splits as evenly as a crowd of simple ones
+void Renderer::DeformDraws(FrameContext& frame) {
+    deformJobs.clear();
+    for (int d = 0; d < (int)frame.draws.size(); d++) {
+        DrawRecord& draw = frame.draws[d];
+        if (draw.deformedOffset < 0 || draw.deformed) continue;
+        uint32_t count = (uint32_t)draw.mesh->vertices.size();
+        for (uint32_t begin = 0; begin < count; begin += kDeformBatchVertices) {
+            deformJobs.push_back({d, begin, std::min(begin + kDeformBatchVertices, count)});
+        }
+        draw.deformed = true;
     }
+    if (deformJobs.empty()) return;
+    ParallelFor((int)deformJobs.size(), [this, &frame](int job) {
+        RunDeformJob(frame, deformJobs[job]);
+    });
+}
 
-    for (size_t i = 0; i < obj.mesh.indices.size(); i += 3) {
-        const VSOutput& vs0 = processedVertices[obj.mesh.indices[i]];
-        const VSOutput& vs1 = processedVertices[obj.mesh.indices[i+1]];
-        const VSOutput& vs2 = processedVertices[obj.mesh.indices[i+2]];
-        Vector3S toCamera = Vector3Sub(cam.position, vs0.worldPos);
-        if (Vector3Dot(vs0.normal, toCamera) <= 0) continue;
+// Nothing samples between one raster and the next, so virtual textures take the feedback
+// the last one left and publish their loaded pages here, once each. Draws record the
+// version they will see: one whose texture gained pages is redrawn, even in tiles an
+// incremental frame would otherwise keep.
+void Renderer::UpdateVirtualTextures(FrameContext& frame) {
+    std::vector<VirtualTexture*>& textures = frameVirtualTextures;
+    textures.clear();
+    for (const DrawRecord& draw : frame.draws) {
+        if (draw.texture && draw.texture->virtualTexture) textures.push_back(draw.texture->virtualTexture.get());
+    }
+    if (textures.empty()) return;
+    std::sort(textures.begin(), textures.end());
+    textures.erase(std::unique(textures.begin(), textures.end()), textures.end());
+    for (VirtualTexture* texture : textures) {
+        texture->Update();
+    }
+    for (DrawRecord& draw : frame.draws) {
+        if (draw.texture && draw.texture->virtualTexture) draw.textureVersion = draw.texture->virtualTexture->GetVersion();
+    }
+}
 
-        std::vector<VSOutput> clippedPolygon = ClipTriangleAgainstFrustum(vs0, vs1, vs2);
+// Bins every deferred draw, splitting them into contiguous runs of similar triangle
+// count, one run per slot, so walking the slots in order still visits draws in order
+void Renderer::BinDraws(FrameContext& frame) {
+    int first = 0;
+    while (first < (int)frame.draws.size() && frame.draws[first].binned) first++;
+    int drawCount = (int)frame.draws.size() - first;
+    if (drawCount == 0) return;
+
+    size_t total = 0;
+    for (int d = first; d < (int)frame.draws.size(); d++) {
+        total += frame.draws[d].indexCount * std::max(1, frame.draws[d].viewCount);
+    }
 
-        if (clippedPolygon.size() >= 3) {
-            // Compute face normal for flat shading (use first 3 vertices)
-            Vector3S edge1 = Vector3Sub(clippedPolygon[1].worldPos, clippedPolygon[0].worldPos);
-            Vector3S edge2 = Vector3Sub(clippedPolygon[2].worldPos, clippedPolygon[0].worldPos);
-            Vector3S faceNormal = Vector3Normalize(Vector3Cross(edge1, edge2));
-            
-            // Compute centroid for flat shading light calculation
-            Vector3S centroid = {
-                (clippedPolygon[0].worldPos.x + clippedPolygon[1].worldPos.x + clippedPolygon[2].worldPos.x) / 3.0f,
-                (clippedPolygon[0].worldPos.y + clippedPolygon[1].worldPos.y + clippedPolygon[2].worldPos.y) / 3.0f,
-                (clippedPolygon[0].worldPos.z + clippedPolygon[1].worldPos.z + clippedPolygon[2].worldPos.z) / 3.0f
-            };
-            float flatIntensity = ComputeLightIntensity(faceNormal, centroid, cam);
+    int slotCount = std::min((int)frame.binSlots.size(), drawCount);
+    std::vector<int>& runStart = binRunStarts;
+    runStart.assign(slotCount + 1, (int)frame.draws.size());
+    runStart[0] = first;
+    size_t accumulated = 0;
+    int run = 1;
+    for (int d = first; d < (int)frame.draws.size() && run < slotCount; d++) {
+        accumulated += frame.draws[d].indexCount * std::max(1, frame.draws[d].viewCount);
+        if (accumulated * slotCount >= total * run) {
+            runStart[run++] = d + 1;
+        }
+    }
 
-            ScreenVertex sv0 = PerspectiveDivide(clippedPolygon[0]);
-            // Compute Gouraud lighting per vertex (pre-divide by w for interpolation)
-            sv0.lightIntensity = ComputeLightIntensity(clippedPolygon[0].normal, clippedPolygon[0].worldPos, cam) * sv0.invW;
-            
-            for (size_t j = 1; j < clippedPolygon.size() - 1; j++) {
-                ScreenVertex sv1 = PerspectiveDivide(clippedPolygon[j]);
-                ScreenVertex sv2 = PerspectiveDivide(clippedPolygon[j + 1]);
-                
-                // Compute Gouraud lighting for other vertices
-                sv1.lightIntensity = ComputeLightIntensity(clippedPolygon[j].normal, clippedPolygon[j].worldPos, cam) * sv1.invW;
-                sv2.lightIntensity = ComputeLightIntensity(clippedPolygon[j + 1].normal, clippedPolygon[j + 1].worldPos, cam) * sv2.invW;
-
-                TriangleData tri;
-                tri.v0 = sv0;
-                tri.v1 = sv1;
-                tri.v2 = sv2;
-                tri.area = EdgeFunction(sv0.position, sv1.position, sv2.position);
-                tri.texture = obj.texture;
-                tri.faceNormal = faceNormal;
-                tri.flatIntensity = flatIntensity;
-
-                if (std::abs(tri.area) < 0.001f) continue;
-
-                tri.minX = std::max(0, (int)std::floor(std::min({sv0.position.x, sv1.position.x, sv2.position.x})));
-                tri.minY = std::max(0, (int)std::floor(std::min({sv0.position.y, sv1.position.y, sv2.position.y})));
-                tri.maxX = std::min(width - 1, (int)std::ceil(std::max({sv0.position.x, sv1.position.x, sv2.position.x})));
-                tri.maxY = std::min(height - 1, (int)std::ceil(std::max({sv0.position.y, sv1.position.y, sv2.position.y})));
-
-                if (tri.minX > tri.maxX || tri.minY > tri.maxY) continue;
-
-                int triIndex = static_cast<int>(triangleBuffer.size());
-                triangleBuffer.push_back(tri);
-                BinTriangleToTiles(triIndex);
-            }
+    ParallelFor(slotCount, [&](int s) {
+        for (int d = runStart[s]; d < runStart[s + 1]; d++) {
+            ProcessDraw(frame, frame.binSlots[s], d);
         }
+    });
+}
+
+enum class MeshletVisibility { Visible, OutsideFrustum, BackFacing };
+
+// A draw's view in the mesh's own space, where the meshlet bounds are
+struct MeshletCullView {
+    float planes[6][4];          // Normalized; in the order of GetPlaneDistance
+    Vector3S camera;
+    bool coneTest;               // Off for mirroring or degenerate transforms
+};
+
+static MeshletCullView MakeMeshletCullView(const Matrix4x4& world, const Matrix4x4& normal, const Matrix4x4& mvp,
+                                           const Vector3S& cameraPosition) {
+    MeshletCullView cull;
+    // Clip-space plane distances are linear in the object-space position, so each plane's
+    // coefficients are sums of MVP columns
+    static const int kPlaneColumns[6][2] = {{0, 3}, {3, 0}, {1, 3}, {3, 1}, {2, -1}, {3, 2}};
+    static const float kPlaneSigns[6][2] = {{1, 1}, {1, -1}, {1, 1}, {1, -1}, {1, 0}, {1, -1}};
+    for (int plane = 0; plane < 6; plane++) {
+        float* c = cull.planes[plane];
+        for (int i = 0; i < 4; i++) {
+            int second = kPlaneColumns[plane][1];
+            c[i] = kPlaneSigns[plane][0] * mvp.m[i][kPlaneColumns[plane][0]] +
+                   (second >= 0 ? kPlaneSigns[plane][1] * mvp.m[i][second] : 0.0f);
+        }
+        float length = sqrtf(c[0] * c[0] + c[1] * c[1] + c[2] * c[2]);
+        if (length < 1e-12f) {
+            c[0] = c[1] = c[2] = 0.0f;
+            c[3] = 1.0f;
+            continue;
+        }
+        for (int i = 0; i < 4; i++) c[i] /= length;
     }
 
-#ifndef __EMSCRIPTEN__
-    int totalTiles = tilesX * tilesY;
-    for (int i = 0; i < totalTiles; i++) {
-        if (!tiles[i].triangleIndices.empty()) {
-            threadPool->Enqueue([this, i, cam]() {
-                RasterizeTile(i, cam);
-            });
+    // The normal matrix is the inverse transpose of the world 3x3, so the camera comes back
+    // into object space through its transpose
+    float det = world.m[0][0] * (world.m[1][1] * world.m[2][2] - world.m[1][2] * world.m[2][1]) -
+                world.m[0][1] * (world.m[1][0] * world.m[2][2] - world.m[1][2] * world.m[2][0]) +
+                world.m[0][2] * (world.m[1][0] * world.m[2][1] - world.m[1][1] * world.m[2][0]);
+    cull.coneTest = det > 1e-8f;
+    Vector3S d = {cameraPosition.x - world.m[3][0], cameraPosition.y - world.m[3][1], cameraPosition.z - world.m[3][2]};
+    cull.camera = {
+        d.x * normal.m[0][0] + d.y * normal.m[0][1] + d.z * normal.m[0][2],
+        d.x * normal.m[1][0] + d.y * normal.m[1][1] + d.z * normal.m[1][2],
+        d.x * normal.m[2][0] + d.y * normal.m[2][1] + d.z * normal.m[2][2]
+    };
+    return cull;
+}
+
+// Conservative: a rejected meshlet has no triangle the clipper or face test would keep
+static MeshletVisibility CullMeshlet(const Meshlet& meshlet, const MeshletCullView& cull) {
+    for (const float* c : cull.planes) {
+        float distance = c[0] * meshlet.center.x + c[1] * meshlet.center.y + c[2] * meshlet.center.z + c[3];
+        if (distance < -meshlet.radius) return MeshletVisibility::OutsideFrustum;
+    }
+    if (cull.coneTest && meshlet.coneCutoff <= 1.0f) {
+        Vector3S toApex = Vector3Sub(meshlet.coneApex, cull.camera);
+        if (Vector3Dot(toApex, meshlet.coneAxis) > meshlet.coneCutoff * Vector3Length(toApex)) {
+            return MeshletVisibility::BackFacing;
         }
     }
-    threadPool->WaitAll();
-#else
-    for (int i = 0; i < (int)tiles.size(); i++) {
-        RasterizeTile(i, cam);
+    return MeshletVisibility::Visible;
+}
+
+static uint32_t NextStamp(BinSlot& slot) {
+    if (++slot.stamp == 0) {
+        // Wrapped: old stamps could match again
+        std::fill(slot.worldStamps.begin(), slot.worldStamps.end(), 0);
+        std::fill(slot.viewStamps.begin(), slot.viewStamps.end(), 0);
+        slot.stamp = 1;
     }
-#endif
-}
\ No newline at end of file
+    return slot.stamp;
+}
+
+// Vertex work, clipping, triangle setup and binning for one draw, into one slot
+void Renderer::ProcessDraw(FrameContext& frame, BinSlot& slot, int drawIndex) {
+    DrawRecord& draw = frame.draws[drawIndex];
+    const MeshS& mesh = *draw.mesh;
+    const Vertex* vertices = GetDrawVertices(frame, draw);
+    const PackedVertices* packed = GetDrawPackedVertices(draw);
+    draw.binned = true;
+
+    const Matrix4x4& matWorld = draw.world;
+    const Matrix4x4& matNormal = draw.normal;
+
+    // Vertices are shaded on first use by a visible meshlet: world-space work once per
+    // draw, shared by every view, and the clip position once per view. The stamps record
+    // which vertices this draw and this view already did.
+    std::vector<VSOutput>& worldVertices = slot.worldVertices;
+    std::vector<VSOutput>& processedVertices = slot.viewVertices;
+    size_t vertexCount = mesh.GetVertexCount();
+    worldVertices.resize(vertexCount);
+    processedVertices.resize(vertexCount);
+    slot.worldStamps.resize(vertexCount, 0);
+    slot.viewStamps.resize(vertexCount, 0);
+    uint32_t worldStamp = NextStamp(slot);
+    slot.geometry.meshVertices += vertexCount;
+
+    // Views are given in output pixels; the frame may be rendering at a lower internal resolution
+    float scaleX = (float)frame.width / (float)width;
+    float scaleY = (float)frame.height / (float)height;
+
+    VSOutput clippedPolygon[kMaxClippedVertices];
+    for (int viewIndex = draw.firstView; viewIndex < draw.firstView + draw.viewCount; viewIndex++) {
+        const ViewS& view = frame.views[viewIndex];
+        const CameraS& cam = view.camera;
+
+        const Matrix4x4& matMVP = frame.viewMVPs[viewIndex];
+        // Packed positions are dequantized by the clip transform itself
+        Matrix4x4 packedMVP = packed ? MultiplyMatrix(PackedPositionMatrix(*packed), matMVP) : matMVP;
+
+        float viewX = view.x * scaleX;
+        float viewY = view.y * scaleY;
+        float viewWidth = view.width * scaleX;
+        float viewHeight = view.height * scaleY;
+        // Scissor: triangles never spill into a neighbouring view's pixels
+        int scissorMinX = std::max(0, (int)std::floor(viewX));
+        int scissorMinY = std::max(0, (int)std::floor(viewY));
+        int scissorMaxX = std::min(frame.width - 1, (int)std::ceil(viewX + viewWidth) - 1);
+        int scissorMaxY = std::min(frame.height - 1, (int)std::ceil(viewY + viewHeight) - 1);
+
+        uint32_t viewStamp = NextStamp(slot);
+        MeshletCullView cull = MakeMeshletCullView(matWorld, matNormal, matMVP, cam.position);
+
+        for (const Meshlet& meshlet : mesh.meshlets) {
+            slot.geometry.meshlets++;
+            // Meshlet bounds are the bind pose's; a deformed mesh may have left them
+            if (meshletCulling && draw.deformedOffset < 0) {
+                MeshletVisibility visibility = CullMeshlet(meshlet, cull);
+                if (visibility == MeshletVisibility::OutsideFrustum) {
+                    slot.geometry.frustumCulled++;
+                    continue;
+                }
+                if (visibility == MeshletVisibility::BackFacing) {
+                    slot.geometry.backfaceCulled++;
+                    continue;
+                }
+            }
+
+            const uint32_t* meshletVertices = &mesh.meshletVertices[meshlet.vertexOffset];
+            uint32_t projected[kMeshletMaxVertices];
+            int projectedCount = 0;
+            for (int v = 0; v < meshlet.vertexCount; v++) {
+                uint32_t k = meshletVertices[v];
+                if (slot.worldStamps[k] != worldStamp) {
+                    worldVertices[k] = VertexShader(packed ? DecodePackedVertex(*packed, k) : vertices[k], matWorld, matNormal);
+                    slot.worldStamps[k] = worldStamp;
+                    slot.geometry.shadedVertices++;
+                }
+                if (slot.viewStamps[k] != viewStamp) {
+                    processedVertices[k] = worldVertices[k];
+                    projected[projectedCount++] = k;
+                    slot.viewStamps[k] = viewStamp;
+                }
+            }
+            // Clip positions of the meshlet's new vertices in one batch
+            Vector4S clipPositions[kMeshletMaxVertices];
+            if (packed) {
+                frame.kernels->transformPackedPoints(packed->positions.data(), projected, projectedCount, packedMVP, clipPositions);
+            } else {
+                frame.kernels->transformPoints(vertices, projected, projectedCount, matMVP, clipPositions);
+            }
+            for (int v = 0; v < projectedCount; v++) {
+                processedVertices[projected[v]].position = clipPositions[v];
+            }
+
+            const uint8_t* meshletTriangles = &mesh.meshletTriangles[meshlet.triangleOffset];
+            for (int t = 0; t < meshlet.triangleCount; t++) {
+                const VSOutput& vs0 = processedVertices[meshletVertices[meshletTriangles[t * 3]]];
+                const VSOutput& vs1 = processedVertices[meshletVertices[meshletTriangles[t * 3 + 1]]];
+                const VSOutput& vs2 = processedVertices[meshletVertices[meshletTriangles[t * 3 + 2]]];
+                // Face orientation from the positions themselves, as the meshlet cones assume
+                Vector3S faceCross = Vector3Cross(Vector3Sub(vs1.worldPos, vs0.worldPos), Vector3Sub(vs2.worldPos, vs0.worldPos));
+                Vector3S toCamera = Vector3Sub(cam.position, vs0.worldPos);
+                if (Vector3Dot(faceCross, toCamera) <= 0) continue;
+
+                int clippedCount = ClipTriangleAgainstFrustum(vs0, vs1, vs2, clippedPolygon);
+
+                if (clippedCount >= 3) {
+                    // Compute face normal for flat shading (use first 3 vertices)
+                    Vector3S edge1 = Vector3Sub(clippedPolygon[1].worldPos, clippedPolygon[0].worldPos);
+                    Vector3S edge2 = Vector3Sub(clippedPolygon[2].worldPos, clippedPolygon[0].worldPos);
+                    Vector3S faceNormal = Vector3Normalize(Vector3Cross(edge1, edge2));
+                    
+                    // Compute centroid for flat shading light calculation
+                    Vector3S centroid = {
+                        (clippedPolygon[0].worldPos.x + clippedPolygon[1].worldPos.x + clippedPolygon[2].worldPos.x) / 3.0f,
+                        (clippedPolygon[0].worldPos.y + clippedPolygon[1].worldPos.y + clippedPolygon[2].worldPos.y) / 3.0f,
+                        (clippedPolygon[0].worldPos.z + clippedPolygon[1].worldPos.z + clippedPolygon[2].worldPos.z) / 3.0f
+                    };
+                    float flatIntensity = ComputeLightIntensity(frame, faceNormal, centroid, cam, false);
+
+                    ScreenVertex sv0 = PerspectiveDivide(clippedPolygon[0], viewX, viewY, viewWidth, viewHeight);
+                    // Compute Gouraud lighting per vertex (pre-divide by w for interpolation)
+                    sv0.lightIntensity = ComputeLightIntensity(frame, clippedPolygon[0].normal, clippedPolygon[0].worldPos, cam, false) * sv0.invW;
+                    
+                    for (int j = 1; j < clippedCount - 1; j++) {
+                        ScreenVertex sv1 = PerspectiveDivide(clippedPolygon[j], viewX, viewY, viewWidth, viewHeight);
+                        ScreenVertex sv2 = PerspectiveDivide(clippedPolygon[j + 1], viewX, viewY, viewWidth, viewHeight);
+                        
+                        // Compute Gouraud lighting for other vertices
+                        sv1.lightIntensity = ComputeLightIntensity(frame, clippedPolygon[j].normal, clippedPolygon[j].worldPos, cam, false) * sv1.invW;
+                        sv2.lightIntensity = ComputeLightIntensity(frame, clippedPolygon[j + 1].normal, clippedPolygon[j + 1].worldPos, cam, false) * sv2.invW;
+
+                        float area = EdgeFunction(sv0.position, sv1.position, sv2.position);
+                        if (std::abs(area) < 0.001f) continue;
+
+                        int minX = std::max(scissorMinX, (int)std::floor(std::min({sv0.position.x, sv1.position.x, sv2.position.x})));
+                        int minY = std::max(scissorMinY, (int)std::floor(std::min({sv0.position.y, sv1.position.y, sv2.position.y})));
+                        int maxX = std::min(scissorMaxX, (int)std::ceil(std::max({sv0.position.x, sv1.position.x, sv2.position.x})));
+                        int maxY = std::min(scissorMaxY, (int)std::ceil(std::max({sv0.position.y, sv1.position.y, sv2.position.y})));
+
+                        if (minX > maxX || minY > maxY) continue;
+
+                        int triIndex = (int)slot.triangles.Allocate();
+                        TriangleData& tri = slot.triangles[triIndex];
+                        tri.minX = (int16_t)minX;
+                        tri.minY = (int16_t)minY;
+                        tri.maxX = (int16_t)maxX;
+                        tri.maxY = (int16_t)maxY;
+                        tri.viewIndex = (uint16_t)viewIndex;
+                        tri.texture = draw.texture;
+                        tri.alpha = draw.alpha;
+                        tri.flatIntensity = flatIntensity;
+                        SetupTriangle(tri, sv0, sv1, sv2, area);
+
+                        draw.minX = std::min(draw.minX, minX);
+                        draw.minY = std::min(draw.minY, minY);
+                        draw.maxX = std::max(draw.maxX, maxX);
+                        draw.maxY = std::max(draw.maxY, maxY);
+
+                        BinTriangleToTiles(frame, slot, triIndex);
+                    }
+                }
+            }
+        }
+    }
+}
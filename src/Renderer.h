@@ -4,6 +4,18 @@
 #include "GameObject.h"
 #include "CameraS.h"
 #include "Texture.h"
+#include "ShadowMap.h"
+#include "ChunkedArena.h"
+#include "SharedFrameRing.h"
+#include "PostProcess.h"
+#include "CpuDispatch.h"
+
+#include <atomic>
+#include <cstdint>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
 
 #ifndef __EMSCRIPTEN__
 #include "ThreadPool.h"
@@ -17,6 +29,21 @@ enum class ShadingMode {
     Unlit       // No lighting, just texture/color
 };
 
+enum class AntiAliasing {
+    None,       // One sample per pixel
+    MSAA4x      // 4 coverage/depth samples per pixel, shaded once per pixel
+};
+
+enum class PerspectiveCorrection {
+    Exact,      // Divide by w at every shaded pixel
+    Span8,      // Divide at every 8th pixel of a span, interpolate linearly in between
+    Span16      // Same, every 16th pixel
+};
+
+static const int kMSAASamples = 4;
+static const int kMaxTransparentLayers = 4;  // Fragments kept per pixel for alpha-blended triangles
+static const int kMaxClippedVertices = 9;   // A triangle clipped by the six frustum planes
+
 struct VSOutput {
     Vector4S position;
     
@@ -35,70 +62,445 @@ struct ScreenVertex {
     float lightIntensity;  // For Gouraud shading (pre-computed per vertex)
 };
 
-struct TriangleData {
-    ScreenVertex v0, v1, v2;
-    float area;
-    int minX, minY, maxX, maxY;
+// Screen-linear values a triangle carries: depth, 1/w, then attributes pre-divided by w
+enum TriangleAttribute {
+    AttrDepth, AttrInvW,
+    AttrWorldX, AttrWorldY, AttrWorldZ,
+    AttrNormalX, AttrNormalY, AttrNormalZ,
+    AttrU, AttrV,
+    AttrLight,
+    AttrCount
+};
+
+// A triangle after setup, in the form the tile loops consume: edge functions and
+// attribute planes taken at its bounding box's top-left pixel. Loops evaluate them at a
+// pixel's offset from there, never stepping from where their tile starts, so results do
+// not depend on how the screen is cut into jobs. Exactly three cache lines.
+struct alignas(64) TriangleData {
+    float edge[3][3];             // Per edge: value, d/dx, d/dy; all three >= 0 inside
+    float attr[AttrCount];        // Values at (minX, minY)
+    float attrDx[AttrCount];
+    float attrDy[AttrCount];
+    float flatIntensity;          // Pre-computed intensity for flat shading
+    uint16_t viewIndex;           // Index into the recording frame's views
+    uint8_t alpha;                // Material opacity; 255 draws opaque with depth writes
     const TextureS* texture;
-    Vector3S faceNormal;     // For flat shading
-    float flatIntensity;     // Pre-computed intensity for flat shading
+    int16_t minX, minY, maxX, maxY;
 };
+static_assert(sizeof(TriangleData) == 192, "TriangleData should stay three cache lines");
 
 struct Tile {
     int startX, startY;
     int endX, endY;
-    std::vector<int> triangleIndices;
+    int triangleCount;       // Summed over all bin slots
+    int transparentCount;    // Of those, alpha-blended ones
+    float cost;              // Estimated raster cost (pixel-equivalents) of binned triangles
+};
+
+static const int kTriangleChunkSize = 1024;  // TriangleData per arena chunk (192 KB)
+static const int kBinChunkSize = 62;         // Indices per bin chunk; 256 bytes with count and link
+
+struct BinChunk {
+    int indices[kBinChunkSize];
+    int count;
+    int next;                // Next chunk of the same list, -1 at the tail
+};
+
+// One tile's list in one slot. Stale unless generation matches the slot's, which is how
+// a slot drops every list at once.
+struct TileBin {
+    int head = -1, tail = -1;
+    uint32_t generation = 0;
+    int count = 0;
+    int transparentCount = 0;
+    float cost = 0.0f;
+};
+
+// Meshlet culling totals since the renderer was created
+struct GeometryStats {
+    size_t meshlets = 0;          // Meshlets considered, once per view drawn into
+    size_t frustumCulled = 0;
+    size_t backfaceCulled = 0;
+    size_t meshVertices = 0;      // Vertices of every mesh drawn: what shading them all would cost
+    size_t shadedVertices = 0;
+};
+
+// Everything one binning thread writes during a frame: its triangles, its chunked
+// per-tile index lists and its geometry scratch. Single-writer, so binning needs no locks;
+// raster walks the slots in order, which keeps triangle order equal to draw order.
+struct BinSlot {
+    ChunkedArena<TriangleData, kTriangleChunkSize> triangles;
+    ChunkedArena<BinChunk, 256> chunks;
+    std::vector<TileBin> tileBins;
+    uint32_t generation = 0;
+    std::vector<VSOutput> worldVertices;
+    std::vector<VSOutput> viewVertices;
+    std::vector<uint32_t> worldStamps;   // Per vertex: the draw that last shaded it
+    std::vector<uint32_t> viewStamps;    // Per vertex: the draw view that last projected it
+    uint32_t stamp = 0;
+    GeometryStats geometry;
+};
+
+// High-water marks of the per-frame binning storage
+struct BinStats {
+    size_t peakTriangles = 0;     // Most triangles binned in one frame
+    size_t peakBinChunks = 0;     // Most bin chunks used in one frame
+    size_t reservedBytes = 0;     // Arena memory held for reuse across both frames
+};
+
+// View and projection matrices of a recently drawn view, shared by every object drawn with it
+struct CachedView {
+    CameraS camera;
+    int width = 0, height = 0;
+    Matrix4x4 view, proj;
+    uint32_t version = 0;        // Unique per camera/size seen; 0 while the entry is empty
+};
+
+// A unit of raster work: a whole tile, or a sub-rectangle of a hot tile
+struct TileJob {
+    int tileIndex;
+    int startX, startY;
+    int endX, endY;
+    float cost;
+};
+
+// A blended surface behind no opaque one yet; colour is not premultiplied
+struct TransparentFragment {
+    float depth;
+    Color color;
+};
+
+// Compact colour/depth for the rectangle one worker is rasterizing; resolved
+// into the linear framebuffer once the rectangle is finished
+struct TileBuffer {
+    int startX, startY;
+    int width, height;
+    int samples;             // Per pixel; colour and depth are stored [pixel][sample]
+    std::vector<Color> color;
+    std::vector<float> depth;
+    // Per pixel, only while the tile has blended triangles: up to kMaxTransparentLayers
+    // fragments sorted nearest first, composited over the resolved colour
+    std::vector<TransparentFragment> fragments;
+    std::vector<unsigned char> fragmentCounts;
+    // Post chain scratch: resolved colour, then float colour and view depth per pixel
+    std::vector<Color> resolved;
+    std::vector<float> postColor, postScratch, postDepth;
+};
+
+// What one DrawMesh call looked like; compared frame to frame to find changed screen regions
+struct DrawRecord {
+    const GameObject* object;
+    const MeshS* mesh;
+    size_t indexCount;
+    const TextureS* texture;
+    uint8_t alpha;               // GameObject::opacity at DrawMesh time
+    Matrix4x4 world;             // From the object's TransformSystem at DrawMesh time
+    Matrix4x4 normal;
+    int minX, minY, maxX, maxY;  // Screen bounds of its binned triangles; minX > maxX if none
+    int firstView, viewCount;    // Range of the frame's views it is drawn into
+    bool binned;                 // Geometry done; otherwise deferred to Render
+    // Skinned or morphed draws: where their pose and deformed vertices are in the frame
+    int deformedOffset = -1;     // Into deformedVertices; -1 draws the mesh's own vertices
+    int paletteOffset = 0, jointCount = 0;
+    int morphOffset = 0, morphCount = 0;
+    bool deformed = false;       // deformedVertices are filled in
+    uint32_t textureVersion = 0; // Of a virtual texture, once its pages are published for the frame
 };
 
+// One batch of a deformed draw's vertices, skinned by one worker
+struct DeformJob {
+    int drawIndex;
+    uint32_t begin, end;
+};
+
+// A draw keyed by its object and how many times that object was drawn before it, so
+// incremental rendering can match it against the same draw last frame
+struct TrackedDraw {
+    const GameObject* object;
+    int occurrence;
+    DrawRecord draw;
+};
+
+enum class FrameMode {
+    LowLatency, // Raster and present each frame before returning from Render
+    Pipelined   // Raster frame N on workers while frame N-1 is presented and N+1 is recorded
+};
+
+// Everything DrawMesh records for one frame; raster jobs read it after Render dispatches
+struct FrameContext {
+    int width = 0, height = 0;   // Internal resolution this frame is rendered at
+    int tileSize = 0;
+    int tilesX = 0, tilesY = 0;
+    std::vector<Tile> tiles;
+    std::vector<BinSlot> binSlots;
+    bool deferGeometry = false;   // Bin in parallel at Render instead of inside DrawMesh
+    std::vector<ViewS> views;
+    std::vector<Matrix4x4> viewMVPs;     // Per entry of views: the drawing object's MVP
+    std::vector<DrawRecord> draws;
+    std::vector<Vertex> deformedVertices;     // Object-space vertices of skinned/morphed draws
+    std::vector<Matrix4x4> jointPalettes;     // Skinning matrices, captured at DrawMesh
+    std::vector<float> morphWeights;
+    ShadingMode shadingMode = ShadingMode::Phong;
+    AntiAliasing antiAliasing = AntiAliasing::None;
+    PerspectiveCorrection perspectiveCorrection = PerspectiveCorrection::Exact;
+    Color clearColor = BLACK;
+    std::vector<LightS> lights;
+    std::vector<ShadowMap> shadowMaps;    // One per light; only valid for shadow casters
+    ShadowQuality shadowQuality = ShadowQuality::Off;
+    PostChain post;                       // Snapshotted by Clear, as binning needs its halo
+    uint32_t postVersion = 0;
+    int postHalo = 0;
+    const CpuKernels* kernels = nullptr;  // Taken by Clear, as pipelined binning runs before Render
+};
+
+// One colour target of the swap chain, plus what the tile clear logic knows about it
+struct FrameBuffer {
+    Color* color = nullptr;
+    std::vector<unsigned char> tileHoldsClear; // Per tile: still nothing but clearColor
+    Color clearColor = BLACK;
+    std::vector<unsigned char> pendingDirty;   // Tiles changed since this buffer was last rendered
+    bool fullyDirty = true;
+    int width = 0, height = 0;                 // Internal resolution of its last frame
+    uint64_t frameNumber = 0;                  // Which frame it holds
+    std::vector<unsigned char> tilesWritten;   // Tiles whose pixels may differ from the frame before
+    int tilesX = 0, tileSize = 0;
+    uint32_t postVersion = 0;                  // Post chain its clear tiles were made with
+};
+
+// Tile grid and empty tiles of the last frame built, to spot tiles empty in both
+struct EmptyTiles {
+    std::vector<unsigned char> empty;
+    int width = 0, height = 0, tileSize = 0;
+    Color clearColor = BLACK;
+    uint32_t postVersion = 0;
+};
+
+struct FrameTimings {
+    float frameMs = 0.0f;    // Render-to-Render wall time
+    float geometryMs = 0.0f; // Vertex work, clipping and binning, wherever it ran
+    float rasterMs = 0.0f;   // Dispatch until the last tile job finished
+    float shadowMs = 0.0f;   // Depth-only shadow map pass, run before the raster dispatch
+};
+
+// Receives every completed frame at output resolution; pixels are only valid during the call
+using FrameSink = std::function<void(const Color* pixels, int width, int height)>;
+
 class Renderer {
 public:
-    Renderer(int width, int height);
+    Renderer(int width, int height, bool headless = false);
     ~Renderer();
 
     void Clear(Color color);
     void Render();
+    // Completes and presents a frame still in flight in pipelined mode
+    void Finish();
+
+    void SetFrameSink(FrameSink sink) { frameSink = std::move(sink); }
 
+    // Moves the swap chain into a named POSIX shared-memory ring, so a local process can
+    // read finished frames in place with SharedFrameReader. False where unsupported.
+    bool EnableSharedFrames(const std::string& name);
+    void DisableSharedFrames();
+    bool IsSharedFramesEnabled() const { return sharedFrames != nullptr; }
+
+    // The transform, texture and pose are captured now; the mesh itself is read until Render
+    // returns (low-latency mode bins in parallel there) and must not change before then.
+    // Brings the object's TransformSystem up to date if anything in it changed.
     void DrawMesh(const GameObject& obj, const CameraS& cam);
+    // Draws one object into several views (split-screen, thumbnail grids, cube faces laid
+    // out side by side). World-space vertex work is done once; each view only projects,
+    // clips and bins, and all views' tiles are rasterized together by Render.
+    void DrawMeshMultiView(const GameObject& obj, const std::vector<ViewS>& views);
 
     void SetTileSize(int size);
     int GetThreadCount() const;
+    // Replaces the worker pool, waiting for any frame still in flight; 0 uses one thread per
+    // core. Takes effect from the next Clear.
+    void SetThreadCount(int count);
 
     void SetShadingMode(ShadingMode mode) { currentShadingMode = mode; }
     ShadingMode GetShadingMode() const { return currentShadingMode; }
     const char* GetShadingModeName() const;
 
+    void SetAntiAliasing(AntiAliasing mode) { antiAliasing = mode; }
+    AntiAliasing GetAntiAliasing() const { return antiAliasing; }
+    const char* GetAntiAliasingName() const;
+
+    // Span modes trade a little accuracy on steeply slanted surfaces for far fewer divides.
+    // MSAA shades at sample centroids and always corrects exactly.
+    void SetPerspectiveCorrection(PerspectiveCorrection mode) { perspectiveCorrection = mode; }
+    PerspectiveCorrection GetPerspectiveCorrection() const { return perspectiveCorrection; }
+    const char* GetPerspectiveCorrectionName() const;
+
+    // Post effects applied inside each tile's raster job, in chain order; taken by Clear.
+    // An empty chain (the default) leaves the rendered pixels as they are.
+    void SetPostChain(const PostChain& chain);
+    const PostChain& GetPostChain() const { return postChain; }
+
+    // Lights are snapshotted by Clear; the default is one shadow-casting directional light
+    void SetLights(const std::vector<LightS>& newLights) { lights = newLights; }
+    const std::vector<LightS>& GetLights() const { return lights; }
+
+    void SetShadowQuality(ShadowQuality quality) { shadowQuality = quality; }
+    ShadowQuality GetShadowQuality() const { return shadowQuality; }
+    const char* GetShadowQualityName() const;
+    void SetShadowMapSize(int size) { shadowMapSize = size; }
+
+    void SetFrameMode(FrameMode mode) { frameMode = mode; }
+    FrameMode GetFrameMode() const { return frameMode; }
+    const char* GetFrameModeName() const;
+
+    // Picks the internal resolution each frame so the frame time tracks targetFrameMs;
+    // the result is bilinearly upscaled to the output size on present
+    void SetDynamicResolution(bool enabled, float targetFrameMs = 16.667f, float minScale = 0.5f);
+    bool IsDynamicResolutionEnabled() const { return dynamicResolution; }
+    float GetResolutionScale() const { return resolutionScale; }
+    const FrameTimings& GetFrameTimings() const { return timings; }
+    BinStats GetBinStats() const;
+    GeometryStats GetGeometryStats() const;
+
+    // Rejects whole meshlets outside the view or facing away before their vertices are
+    // transformed; the per-triangle tests make the same decisions either way
+    void SetMeshletCulling(bool enabled) { meshletCulling = enabled; }
+    bool IsMeshletCullingEnabled() const { return meshletCulling; }
+
+    // Re-rasterize only tiles touched by objects whose transform, mesh or texture
+    // changed; the rest keep the previous frame's pixels
+    void SetIncrementalRendering(bool enabled) { incrementalRendering = enabled; }
+    bool IsIncrementalRenderingEnabled() const { return incrementalRendering; }
+    // Forces the next frame to redraw everything, e.g. after editing a mesh in place
+    void InvalidateFrame() { forceFullRedraw = true; }
+
+    // Instruction set of the raster, sampling, vertex and clear/resolve kernels. Picked at
+    // construction from the CPU and RENDERER_CPU; levels the CPU lacks fall back to the
+    // best one it has. Every level renders identical frames. Taken by Clear.
+    void SetCpuLevel(CpuLevel level);
+    CpuLevel GetCpuLevel() const { return cpuKernels->level; }
+    const char* GetCpuLevelName() const { return CpuLevelName(cpuKernels->level); }
+
 private:
+    using Clock = std::chrono::steady_clock;
+
     int width, height;
-    Color* pixelBuffer;
-    float* depthBuffer;
-    Texture2D screenTexture;
+    bool headless;
+    FrameSink frameSink;
+    FrameBuffer buffers[2];
+    int backBuffer = 0;
+    Color* pixelBuffer;      // Buffer tiles are currently resolved into
+    Color* upscaleBuffer = nullptr;
+    Texture2D screenTexture = {};
+    std::unique_ptr<SharedFrameRing> sharedFrames;
+    uint64_t renderedFrames = 0;
+    uint64_t uploadedFrame = 0;          // Frame screenTexture holds
+    std::vector<Color> uploadStaging;    // Packs rectangles narrower than the screen
+    EmptyTiles previousEmptyTiles;
+
+    bool dynamicResolution = false;
+    float targetFrameMs = 16.667f;
+    float minResolutionScale = 0.5f;
+    float resolutionScale = 1.0f;
+    FrameTimings timings;
+
+    bool meshletCulling = true;
+    bool incrementalRendering = false;
+    bool forceFullRedraw = true;
+    std::vector<TrackedDraw> previousDraws;  // Sorted by (object, occurrence)
+    std::vector<TrackedDraw> currentDraws;
+    FrameContext previousView;         // Only views/modes/size are kept, to detect view changes
+    std::vector<unsigned char> frameDirty;
+    Clock::time_point frameStartTime;
+    Clock::time_point lastRenderTime;
+    Clock::time_point rasterStartTime;
+    Clock::time_point rasterEndTime;   // Written by whichever tile job finishes last
+    std::atomic<int> rasterJobsRemaining{0};
+
+    FrameContext frames[2];
+    int recordFrame = 0;     // Frame DrawMesh is currently binning into
+    const FrameContext* rasterFrame = nullptr;
+    FrameMode frameMode = FrameMode::LowLatency;
+    bool previousFrameReady = false;
 
 #ifndef __EMSCRIPTEN__
     std::unique_ptr<ThreadPool> threadPool;
     unsigned int numThreads;
 #endif
+    const CpuKernels* cpuKernels;
 
     int tileSize;
-    int tilesX, tilesY;
-    std::vector<Tile> tiles;
-    std::vector<TriangleData> triangleBuffer;
+    std::vector<TileJob> tileJobs;
+    std::vector<DeformJob> deformJobs;
+    std::vector<VirtualTexture*> frameVirtualTextures;
+    std::vector<int> binRunStarts;
+    CachedView viewCache[kCachedViews];  // Slots match TransformSystem's per-object MVP slots
+    uint32_t nextViewVersion = 1;
+    int nextViewSlot = 0;
     ShadingMode currentShadingMode = ShadingMode::Phong;
-    Font uiFont;
+    AntiAliasing antiAliasing = AntiAliasing::None;
+    PerspectiveCorrection perspectiveCorrection = PerspectiveCorrection::Exact;
+    Font uiFont = {};
+
+    std::vector<LightS> lights = {LightS()};
+    PostChain postChain;
+    uint32_t postChainVersion = 0;
+    ShadowQuality shadowQuality = ShadowQuality::Off;
+    int shadowMapSize = 1024;
+    // Shadow pass scratch, indexed by draw and by light * draws + draw
+    std::vector<std::vector<Vector3S>> shadowCasterVertices;
+    std::vector<Vector3S> shadowCasterBounds;
+    std::vector<std::vector<ShadowTriangle>> shadowTriangles;
+    std::vector<int> shadowCasters;
+    std::vector<std::pair<int, int>> shadowBands;  // (light, first row)
 
-    void InitTiles();
-    void ClearTiles();
-    void BinTriangleToTiles(int triangleIndex);
-    void RasterizeTile(int tileIndex, const CameraS& cam);
-    void RasterizeTriangleInTile(const TriangleData& tri, const Tile& tile, const CameraS& cam);
+    void InitTiles(FrameContext& frame, int renderWidth, int renderHeight);
+    void ClearTiles(FrameContext& frame);
+    void UpdateResolutionScale();
+    void UpscaleRows(const FrameBuffer& source, int startY, int endY);
+    void ResetBinSlots(FrameContext& frame);
+    void BinTriangleToTiles(const FrameContext& frame, BinSlot& slot, int triangleIndex);
+    void BinDraws(FrameContext& frame);
+    void ProcessDraw(FrameContext& frame, BinSlot& slot, int drawIndex);
+    void CaptureDeformation(FrameContext& frame, DrawRecord& draw, const GameObject& obj);
+    void DeformDraws(FrameContext& frame);
+    void UpdateVirtualTextures(FrameContext& frame);
+    void RunDeformJob(FrameContext& frame, const DeformJob& job);
+    void MergeBins(FrameContext& frame);
+    float EstimateTriangleCost(const TriangleData& tri, int startX, int startY, int endX, int endY) const;
+    void UpdateDirtyTiles(const FrameContext& frame);
+    void MarkDirtyBounds(const FrameContext& frame, int minX, int minY, int maxX, int maxY);
+    bool ViewChanged(const FrameContext& frame) const;
+    int CacheView(const ViewS& view);
+    void BuildTileJobs(const FrameContext& frame);
+    void SplitTileJob(const FrameContext& frame, const TileJob& job, float targetCost, int minSize);
+    void ParallelFor(int count, const std::function<void(int)>& fn);
+    void RenderShadowMaps(FrameContext& frame);
+    void SetupShadowTriangles(const FrameContext& frame, int lightIndex, int drawIndex);
+    bool ShadowsActive(const FrameContext& frame) const;
+    void DispatchRaster(const FrameContext& frame);
+    const Color* GetOutputPixels(const FrameBuffer& frameBuffer);
+    void Present(const FrameBuffer* frameBuffer);
+    void UploadFrame(const FrameBuffer& frameBuffer, const Color* pixels);
+    void SetColorBuffers(Color* first, Color* second);
+    void ClearTileRect(const TileJob& job, Color color);
+    void ResolveTile(const TileBuffer& tileBuffer, Color* dst, int stride);
+    void CompositeFragments(const TileBuffer& tileBuffer, Color* dst, int stride);
+    void PostProcessTile(const FrameContext& frame, TileBuffer& tileBuffer, const TileJob& job);
+    void RasterizeTile(const TileJob& job);
+    void RasterizeTriangleInTile(const TriangleData& tri, TileBuffer& tileBuffer, const CameraS& cam, int spanLength);
+    void RasterizeTriangleInTileMSAA(const TriangleData& tri, TileBuffer& tileBuffer, const CameraS& cam);
+    ScreenVertex InterpolateVertex(const float* attributes, const Vector3S& p);
+    void SetupTriangle(TriangleData& tri, const ScreenVertex& v0, const ScreenVertex& v1, const ScreenVertex& v2, float area);
 
-    VSOutput VertexShader(const Vertex& vertex, const Matrix4x4& mvp, const Matrix4x4& worldMat, const Matrix4x4& normalMat, const CameraS& cam);
+    void DrawMeshViews(const GameObject& obj, const ViewS* views, int viewCount);
+    VSOutput VertexShader(const Vertex& vertex, const Matrix4x4& worldMat, const Matrix4x4& normalMat);
     Color FragmentShader(const ScreenVertex& interpolated, const CameraS& cam, const TextureS* texture, const TriangleData& tri);
-    ScreenVertex PerspectiveDivide(const VSOutput& in);
-    float ComputeLightIntensity(const Vector3S& normal, const Vector3S& worldPos, const CameraS& cam);
-    float ComputeDiffuseOnly(const Vector3S& normal);
+    ScreenVertex PerspectiveDivide(const VSOutput& in, float viewX, float viewY, float viewWidth, float viewHeight);
+    float ComputeLightIntensity(const FrameContext& frame, const Vector3S& normal, const Vector3S& worldPos, const CameraS& cam, bool shadowed);
+    float ComputeDiffuseOnly(const FrameContext& frame, const Vector3S& normal, const Vector3S& worldPos, bool shadowed);
+    float ShadowVisibility(const FrameContext& frame, const Vector3S& worldPos) const;
+    Vector3S LightDirectionAt(const LightS& light, const Vector3S& worldPos, float& attenuation) const;
 
-    std::vector<VSOutput> ClipTriangleAgainstFrustum(const VSOutput& v0, const VSOutput& v1, const VSOutput& v2);
-    std::vector<VSOutput> ClipPolygonAgainstPlane(const std::vector<VSOutput>& polygon, int planeIndex);
+    int ClipTriangleAgainstFrustum(const VSOutput& v0, const VSOutput& v1, const VSOutput& v2, VSOutput* out);
+    int ClipPolygonAgainstPlane(const VSOutput* polygon, int count, int planeIndex, VSOutput* out);
     float GetPlaneDistance(const Vector4S& v0, int planeIndex);
     VSOutput LerpVSOutput(const VSOutput& a, const VSOutput& b, float t);
 
@@ -0,0 +1,265 @@
+#pragma once
+#include "MathS.h"
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+enum class LightType {
+    Directional,  // Parallel rays along direction; orthographic shadow map
+    Spot          // Cone from position along direction; perspective shadow map
+};
+
+struct LightS {
+    LightType type = LightType::Directional;
+    Vector3S direction = {0.5f, 0.4f, 1.0f};  // Direction the light travels
+    Vector3S position = {0.0f, 0.0f, 0.0f};   // Spot only
+    float spotAngle = 0.6f;                    // Spot only: half-angle of the cone, radians
+    float intensity = 1.0f;
+    bool castShadows = true;
+    float shadowBias = 0.001f;                 // Constant depth offset, in shadow map depth units
+};
+
+enum class ShadowQuality {
+    Off,
+    Hard,       // One depth comparison per lookup
+    PCF3x3      // Average of 3x3 depth comparisons
+};
+
+static const int kShadowSubpixelBits = 3;
+static const int kMaxShadowMapSize = 2048;  // Keeps fixed-point edge functions within 32 bits
+static const float kShadowSlopeBias = 1.5f; // Depth offset per unit of depth slope across a texel
+
+// A caster triangle after light-space setup: fixed-point vertices, pixel bounds and a depth plane
+struct ShadowTriangle {
+    int x0, y0, x1, y1, x2, y2;  // Counter-clockwise in map pixels, kShadowSubpixelBits of fraction
+    int minX, minY, maxX, maxY;
+    float depth0;                // Biased depth at the centre of pixel (0, 0)
+    float depthDx, depthDy;
+};
+
+class ShadowMap {
+public:
+    int size = 0;
+    std::vector<float> depth;
+    Matrix4x4 viewProj = Matrix4x4::Identity();
+    bool valid = false;          // Rendered this frame; lookups on an invalid map are fully lit
+
+    void Resize(int newSize) {
+        // Rows are rasterized four texels at a time
+        newSize = std::max(4, std::min(kMaxShadowMapSize, (newSize + 3) & ~3));
+        if (newSize == size) return;
+        size = newSize;
+        depth.assign((size_t)size * size, std::numeric_limits<float>::max());
+    }
+
+    // Fits the light's projection around the world-space bounds of everything that casts
+    void Setup(const LightS& light, const Vector3S& boundsMin, const Vector3S& boundsMax) {
+        Vector3S forward = Vector3Normalize(light.direction);
+        Vector3S upRef = std::abs(forward.y) > 0.99f ? Vector3S{1.0f, 0.0f, 0.0f} : Vector3S{0.0f, 1.0f, 0.0f};
+        Vector3S right = Vector3Normalize(Vector3Cross(upRef, forward));
+        Vector3S up = Vector3Cross(forward, right);
+
+        Matrix4x4 view = Matrix4x4::Identity();
+        view.m[0][0] = right.x; view.m[0][1] = up.x; view.m[0][2] = forward.x;
+        view.m[1][0] = right.y; view.m[1][1] = up.y; view.m[1][2] = forward.y;
+        view.m[2][0] = right.z; view.m[2][1] = up.z; view.m[2][2] = forward.z;
+        if (light.type == LightType::Spot) {
+            view = MultiplyMatrix(MatrixMakeTranslation(-light.position.x, -light.position.y, -light.position.z), view);
+        }
+
+        const float big = std::numeric_limits<float>::max();
+        Vector3S lo = {big, big, big};
+        Vector3S hi = {-big, -big, -big};
+        for (int i = 0; i < 8; i++) {
+            Vector3S corner = {
+                (i & 1) ? boundsMax.x : boundsMin.x,
+                (i & 2) ? boundsMax.y : boundsMin.y,
+                (i & 4) ? boundsMax.z : boundsMin.z
+            };
+            Vector3S p = MultiplyVectorMatrix(corner, view);
+            lo = {std::min(lo.x, p.x), std::min(lo.y, p.y), std::min(lo.z, p.z)};
+            hi = {std::max(hi.x, p.x), std::max(hi.y, p.y), std::max(hi.z, p.z)};
+        }
+
+        Matrix4x4 proj = Matrix4x4::Identity();
+        if (light.type == LightType::Directional) {
+            // Orthographic: x, y to [-1, 1] and depth to [0, 1] over the casters' extent
+            float sx = 2.0f / std::max(1e-4f, hi.x - lo.x);
+            float sy = 2.0f / std::max(1e-4f, hi.y - lo.y);
+            float sz = 1.0f / std::max(1e-4f, hi.z - lo.z);
+            proj.m[0][0] = sx;
+            proj.m[1][1] = sy;
+            proj.m[2][2] = sz;
+            proj.m[3][0] = -(hi.x + lo.x) * 0.5f * sx;
+            proj.m[3][1] = -(hi.y + lo.y) * 0.5f * sy;
+            proj.m[3][2] = -lo.z * sz;
+        } else {
+            // Near plane as far out as the casters allow, for depth precision
+            float farZ = std::max(0.2f, hi.z * 1.01f);
+            float nearZ = std::max(0.1f, std::min(lo.z * 0.99f, farZ * 0.5f));
+            float fovDeg = 2.0f * light.spotAngle * 180.0f / 3.14159f;
+            proj = MatrixMakeProjection(fovDeg, 1.0f, nearZ, farZ);
+        }
+        viewProj = MultiplyMatrix(view, proj);
+    }
+
+    void ClearRows(int startY, int endY) {
+        std::fill(depth.begin() + (size_t)startY * size, depth.begin() + (size_t)endY * size,
+                  std::numeric_limits<float>::max());
+    }
+
+    // Builds a caster triangle from map-space vertices (x, y in texels, z in depth units).
+    // Casters are double-sided, so winding is normalized rather than culled.
+    static bool SetupTriangle(Vector3S a, Vector3S b, Vector3S c, float bias, int mapSize, ShadowTriangle& out) {
+        const float scale = (float)(1 << kShadowSubpixelBits);
+        const int limit = (mapSize + 1) << kShadowSubpixelBits;
+        auto toFixed = [&](float v) {
+            return std::max(-(1 << kShadowSubpixelBits), std::min(limit, (int)std::lround(v * scale)));
+        };
+
+        int ax = toFixed(a.x), ay = toFixed(a.y);
+        int bx = toFixed(b.x), by = toFixed(b.y);
+        int cx = toFixed(c.x), cy = toFixed(c.y);
+        int64_t area = (int64_t)(bx - ax) * (cy - ay) - (int64_t)(by - ay) * (cx - ax);
+        if (area == 0) return false;
+        if (area < 0) {
+            std::swap(bx, cx);
+            std::swap(by, cy);
+            std::swap(b, c);
+        }
+
+        out.x0 = ax; out.y0 = ay;
+        out.x1 = bx; out.y1 = by;
+        out.x2 = cx; out.y2 = cy;
+        out.minX = std::max(0, std::min({ax, bx, cx}) >> kShadowSubpixelBits);
+        out.minY = std::max(0, std::min({ay, by, cy}) >> kShadowSubpixelBits);
+        out.maxX = std::min(mapSize - 1, std::max({ax, bx, cx}) >> kShadowSubpixelBits);
+        out.maxY = std::min(mapSize - 1, std::max({ay, by, cy}) >> kShadowSubpixelBits);
+        if (out.minX > out.maxX || out.minY > out.maxY) return false;
+
+        // Depth is affine in screen space for both projections (z/w), so a plane suffices
+        float e1x = b.x - a.x, e1y = b.y - a.y, e1z = b.z - a.z;
+        float e2x = c.x - a.x, e2y = c.y - a.y, e2z = c.z - a.z;
+        float det = e1x * e2y - e2x * e1y;
+        if (std::abs(det) < 1e-12f) return false;
+        out.depthDx = (e1z * e2y - e2z * e1y) / det;
+        out.depthDy = (e2z * e1x - e1z * e2x) / det;
+        float slope = std::max(std::abs(out.depthDx), std::abs(out.depthDy));
+        out.depth0 = a.z - out.depthDx * (a.x - 0.5f) - out.depthDy * (a.y - 0.5f) + bias + kShadowSlopeBias * slope;
+        return true;
+    }
+
+    // Depth-only raster of one triangle, limited to rows [startY, endY). No attributes are
+    // interpolated and nothing but depth is written. Edges are inclusive: a texel on a
+    // shared edge may be written twice, which a min-depth write doesn't mind.
+    void RasterizeTriangle(const ShadowTriangle& tri, int startY, int endY) {
+        int minY = std::max(tri.minY, startY);
+        int maxY = std::min(tri.maxY, endY - 1);
+        if (minY > maxY) return;
+
+        const int one = 1 << kShadowSubpixelBits;
+        const int half = one >> 1;
+        // E(p) = (b - a) x (p - a); steps per texel in x and y
+        int a01 = (tri.y0 - tri.y1) * one, b01 = (tri.x1 - tri.x0) * one;
+        int a12 = (tri.y1 - tri.y2) * one, b12 = (tri.x2 - tri.x1) * one;
+        int a20 = (tri.y2 - tri.y0) * one, b20 = (tri.x0 - tri.x2) * one;
+
+        int startX = tri.minX & ~3;
+        int px = startX * one + half;
+        int py = minY * one + half;
+        int e01Row = (tri.x1 - tri.x0) * (py - tri.y0) - (tri.y1 - tri.y0) * (px - tri.x0);
+        int e12Row = (tri.x2 - tri.x1) * (py - tri.y1) - (tri.y2 - tri.y1) * (px - tri.x1);
+        int e20Row = (tri.x0 - tri.x2) * (py - tri.y2) - (tri.y0 - tri.y2) * (px - tri.x2);
+        float zRow = tri.depth0 + tri.depthDx * startX + tri.depthDy * minY;
+
+#if defined(__SSE2__)
+        const __m128i step01 = _mm_set1_epi32(a01 * 4);
+        const __m128i step12 = _mm_set1_epi32(a12 * 4);
+        const __m128i step20 = _mm_set1_epi32(a20 * 4);
+        const __m128i lane01 = _mm_setr_epi32(0, a01, a01 * 2, a01 * 3);
+        const __m128i lane12 = _mm_setr_epi32(0, a12, a12 * 2, a12 * 3);
+        const __m128i lane20 = _mm_setr_epi32(0, a20, a20 * 2, a20 * 3);
+        const __m128 laneZ = _mm_setr_ps(0.0f, tri.depthDx, tri.depthDx * 2.0f, tri.depthDx * 3.0f);
+        const __m128 stepZ = _mm_set1_ps(tri.depthDx * 4.0f);
+        const __m128i minusOne = _mm_set1_epi32(-1);
+#endif
+
+        for (int y = minY; y <= maxY; y++) {
+            float* row = depth.data() + (size_t)y * size;
+#if defined(__SSE2__)
+            __m128i e01 = _mm_add_epi32(_mm_set1_epi32(e01Row), lane01);
+            __m128i e12 = _mm_add_epi32(_mm_set1_epi32(e12Row), lane12);
+            __m128i e20 = _mm_add_epi32(_mm_set1_epi32(e20Row), lane20);
+            __m128 z = _mm_add_ps(_mm_set1_ps(zRow), laneZ);
+            for (int x = startX; x <= tri.maxX; x += 4) {
+                // Inside where no edge function is negative
+                __m128i inside = _mm_cmpgt_epi32(_mm_or_si128(_mm_or_si128(e01, e12), e20), minusOne);
+                if (_mm_movemask_epi8(inside)) {
+                    __m128 mask = _mm_castsi128_ps(inside);
+                    __m128 old = _mm_loadu_ps(row + x);
+                    __m128 nearer = _mm_min_ps(old, z);
+                    _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(mask, nearer), _mm_andnot_ps(mask, old)));
+                }
+                e01 = _mm_add_epi32(e01, step01);
+                e12 = _mm_add_epi32(e12, step12);
+                e20 = _mm_add_epi32(e20, step20);
+                z = _mm_add_ps(z, stepZ);
+            }
+#else
+            int e01 = e01Row, e12 = e12Row, e20 = e20Row;
+            float z = zRow;
+            for (int x = startX; x <= tri.maxX; x++) {
+                if ((e01 | e12 | e20) >= 0 && z < row[x]) {
+                    row[x] = z;
+                }
+                e01 += a01;
+                e12 += a12;
+                e20 += a20;
+                z += tri.depthDx;
+            }
+#endif
+            e01Row += b01;
+            e12Row += b12;
+            e20Row += b20;
+            zRow += tri.depthDy;
+        }
+    }
+
+    // 1 where worldPos sees the light, 0 where a caster is nearer; fractional with PCF.
+    // Points outside the map are treated as lit.
+    float Visibility(const Vector3S& worldPos, ShadowQuality quality) const {
+        if (!valid) return 1.0f;
+        Vector4S clip = MultiplyVectorMatrix4(worldPos, viewProj);
+        if (clip.w <= 0.0f) return 1.0f;
+        float invW = 1.0f / clip.w;
+        float z = clip.z * invW;
+        if (z < 0.0f || z > 1.0f) return 1.0f;
+        float x = (clip.x * invW + 1.0f) * 0.5f * size;
+        float y = (clip.y * invW + 1.0f) * 0.5f * size;
+        int px = (int)std::floor(x);
+        int py = (int)std::floor(y);
+
+        if (quality != ShadowQuality::PCF3x3) {
+            return Lit(px, py, z) ? 1.0f : 0.0f;
+        }
+        int lit = 0;
+        for (int dy = -1; dy <= 1; dy++) {
+            for (int dx = -1; dx <= 1; dx++) {
+                lit += Lit(px + dx, py + dy, z);
+            }
+        }
+        return lit * (1.0f / 9.0f);
+    }
+
+private:
+    int Lit(int x, int y, float z) const {
+        if (x < 0 || y < 0 || x >= size || y >= size) return 1;
+        return z <= depth[(size_t)y * size + x];
+    }
+};
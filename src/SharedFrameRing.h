@@ -0,0 +1,216 @@
+#pragma once
+#include "raylib.h"
+#include <string>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <new>
+
+#if !defined(__EMSCRIPTEN__) && (defined(__unix__) || defined(__APPLE__))
+#define SHARED_FRAMES_SUPPORTED 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const uint32_t kSharedFrameMagic = 0x53524652;   // "SRFR"
+static const uint32_t kSharedFrameVersion = 1;
+static const int kSharedFrameSlots = 2;                 // One per swap chain buffer
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "Sequence numbers must be address-free across processes");
+
+// Sequence numbers are a per-slot seqlock: odd while the renderer writes the slot,
+// 2 * frame number once the frame is complete
+struct SharedFrameSlot {
+    std::atomic<uint64_t> sequence;
+    uint32_t width;          // Rendered region; below output size under dynamic resolution
+    uint32_t height;
+};
+
+// Start of the mapping; slot pixels follow at pixelOffset, slotBytes apart
+struct SharedFrameHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t stride;         // Pixels per row of every slot (the output width)
+    uint32_t rows;           // Rows per slot (the output height)
+    uint32_t slotCount;
+    uint32_t pixelOffset;
+    uint64_t slotBytes;
+    std::atomic<uint64_t> latestSequence;   // Newest complete frame, 0 before the first
+    std::atomic<uint32_t> latestSlot;
+    SharedFrameSlot slots[kSharedFrameSlots];
+};
+
+static inline std::string SharedFrameObjectName(const std::string& name) {
+    return name.empty() || name[0] == '/' ? name : "/" + name;
+}
+
+// Renderer side. The swap chain buffers live in the mapping, so tiles are resolved
+// straight into shared memory and publishing a frame copies nothing.
+class SharedFrameRing {
+public:
+    ~SharedFrameRing() { Close(); }
+
+    bool Create(const std::string& name, int width, int height) {
+#ifdef SHARED_FRAMES_SUPPORTED
+        objectName = SharedFrameObjectName(name);
+        size_t pixelOffset = (sizeof(SharedFrameHeader) + 63) & ~(size_t)63;
+        size_t slotBytes = ((size_t)width * height * sizeof(Color) + 63) & ~(size_t)63;
+        mappedBytes = pixelOffset + slotBytes * kSharedFrameSlots;
+
+        int fd = shm_open(objectName.c_str(), O_CREAT | O_RDWR, 0600);
+        if (fd < 0) {
+            perror("shm_open");
+            return false;
+        }
+        if (ftruncate(fd, (off_t)mappedBytes) != 0) {
+            perror("ftruncate");
+            close(fd);
+            shm_unlink(objectName.c_str());
+            return false;
+        }
+        void* memory = mmap(nullptr, mappedBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (memory == MAP_FAILED) {
+            perror("mmap");
+            shm_unlink(objectName.c_str());
+            return false;
+        }
+
+        base = (unsigned char*)memory;
+        header = new (base) SharedFrameHeader();
+        header->stride = (uint32_t)width;
+        header->rows = (uint32_t)height;
+        header->slotCount = kSharedFrameSlots;
+        header->pixelOffset = (uint32_t)pixelOffset;
+        header->slotBytes = slotBytes;
+        header->latestSequence.store(0, std::memory_order_relaxed);
+        header->latestSlot.store(0, std::memory_order_relaxed);
+        for (SharedFrameSlot& slot : header->slots) {
+            slot.sequence.store(0, std::memory_order_relaxed);
+            slot.width = slot.height = 0;
+        }
+        header->version = kSharedFrameVersion;
+        // Readers check the magic last
+        std::atomic_thread_fence(std::memory_order_release);
+        header->magic = kSharedFrameMagic;
+        return true;
+#else
+        (void)name; (void)width; (void)height;
+        return false;
+#endif
+    }
+
+    void Close() {
+#ifdef SHARED_FRAMES_SUPPORTED
+        if (!base) return;
+        munmap(base, mappedBytes);
+        shm_unlink(objectName.c_str());
+        base = nullptr;
+        header = nullptr;
+#endif
+    }
+
+    Color* GetPixels(int slot) const {
+        return (Color*)(base + header->pixelOffset + header->slotBytes * slot);
+    }
+
+    // Before any tile of the slot is written
+    void BeginWrite(int slot) {
+        frameNumber++;
+        header->slots[slot].sequence.store(frameNumber * 2 - 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+
+    // After every tile job of the slot has finished
+    void Publish(int slot, int width, int height) {
+        SharedFrameSlot& target = header->slots[slot];
+        uint64_t sequence = target.sequence.load(std::memory_order_relaxed);
+        if ((sequence & 1) == 0) return;   // Already published
+        target.width = (uint32_t)width;
+        target.height = (uint32_t)height;
+        target.sequence.store(sequence + 1, std::memory_order_release);
+        header->latestSlot.store((uint32_t)slot, std::memory_order_relaxed);
+        header->latestSequence.store(sequence + 1, std::memory_order_release);
+    }
+
+private:
+    std::string objectName;
+    unsigned char* base = nullptr;
+    SharedFrameHeader* header = nullptr;
+    size_t mappedBytes = 0;
+    uint64_t frameNumber = 0;
+};
+
+// Consumer side, for tools in another process. Frames are read in place: the callback
+// sees the slot's pixels directly and ReadLatest then checks the renderer didn't start
+// overwriting them meanwhile. The renderer never waits for readers, so a reader slower
+// than two frames simply gets false and tries the next one.
+class SharedFrameReader {
+public:
+    ~SharedFrameReader() { Close(); }
+
+    bool Open(const std::string& name) {
+#ifdef SHARED_FRAMES_SUPPORTED
+        std::string objectName = SharedFrameObjectName(name);
+        int fd = shm_open(objectName.c_str(), O_RDONLY, 0);
+        if (fd < 0) return false;
+        struct stat info;
+        if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(SharedFrameHeader)) {
+            close(fd);
+            return false;
+        }
+        void* memory = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (memory == MAP_FAILED) return false;
+
+        base = (const unsigned char*)memory;
+        mappedBytes = (size_t)info.st_size;
+        header = (const SharedFrameHeader*)base;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (header->magic != kSharedFrameMagic || header->version != kSharedFrameVersion) {
+            Close();
+            return false;
+        }
+        return true;
+#else
+        (void)name;
+        return false;
+#endif
+    }
+
+    void Close() {
+#ifdef SHARED_FRAMES_SUPPORTED
+        if (!base) return;
+        munmap((void*)base, mappedBytes);
+        base = nullptr;
+        header = nullptr;
+#endif
+    }
+
+    uint64_t GetLatestSequence() const { return header ? header->latestSequence.load(std::memory_order_acquire) : 0; }
+
+    // Calls consume(pixels, width, height, stride, sequence) on the newest complete frame.
+    // False if there is none yet or it was overwritten during the call, in which case
+    // whatever consume derived from the pixels must be discarded.
+    template <typename Consume>
+    bool ReadLatest(Consume consume) const {
+        if (!header) return false;
+        uint64_t latest = header->latestSequence.load(std::memory_order_acquire);
+        if (latest == 0) return false;
+        const SharedFrameSlot& slot = header->slots[header->latestSlot.load(std::memory_order_relaxed)];
+        uint64_t before = slot.sequence.load(std::memory_order_acquire);
+        if (before & 1) return false;
+        const Color* pixels = (const Color*)(base + header->pixelOffset + header->slotBytes * (&slot - header->slots));
+        consume(pixels, (int)slot.width, (int)slot.height, (int)header->stride, before);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return slot.sequence.load(std::memory_order_relaxed) == before;
+    }
+
+private:
+    const unsigned char* base = nullptr;
+    const SharedFrameHeader* header = nullptr;
+    size_t mappedBytes = 0;
+};
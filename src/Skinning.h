@@ -0,0 +1,80 @@
+#pragma once
+#include "Components.h"
+#include "MathS.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+static const uint32_t kDeformBatchVertices = 512;   // Vertices per deform job
+
+// Morphs, then linear-blend skins vertices [begin, end) of mesh into out, which holds
+// end - begin vertices. palette is null for a mesh that is only morphed; otherwise it has
+// one skinning matrix (inverse bind * joint pose) per joint. Normals come out unnormalized,
+// as VertexShader normalizes after the normal matrix anyway.
+inline void DeformVertices(const MeshS& mesh, const Matrix4x4* palette, const float* morphWeights, int morphCount,
+                           uint32_t begin, uint32_t end, Vertex* out) {
+    std::copy(mesh.vertices.begin() + begin, mesh.vertices.begin() + end, out);
+
+    for (int t = 0; t < morphCount; t++) {
+        float weight = morphWeights[t];
+        if (weight == 0.0f) continue;
+        const MorphTarget& target = mesh.morphTargets[t];
+        size_t i = std::lower_bound(target.vertices.begin(), target.vertices.end(), begin) - target.vertices.begin();
+        bool normals = !target.normalDeltas.empty();
+        for (; i < target.vertices.size() && target.vertices[i] < end; i++) {
+            Vertex& v = out[target.vertices[i] - begin];
+            v.position = Vector3Add(v.position, Vector3Scale(target.positionDeltas[i], weight));
+            if (normals) v.normal = Vector3Add(v.normal, Vector3Scale(target.normalDeltas[i], weight));
+        }
+    }
+    if (!palette) return;
+
+    const SkinWeights* skin = mesh.skin.data() + begin;
+    for (uint32_t i = 0; i < end - begin; i++) {
+        const SkinWeights& s = skin[i];
+        Vertex& v = out[i];
+#if defined(__SSE2__)
+        // Blend the four weighted matrices row by row, then transform as a row vector
+        __m128 rows[4];
+        for (int r = 0; r < 4; r++) {
+            __m128 sum = _mm_mul_ps(_mm_set1_ps(s.weights[0]), _mm_loadu_ps(palette[s.joints[0]].m[r]));
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(s.weights[1]), _mm_loadu_ps(palette[s.joints[1]].m[r])));
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(s.weights[2]), _mm_loadu_ps(palette[s.joints[2]].m[r])));
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(s.weights[3]), _mm_loadu_ps(palette[s.joints[3]].m[r])));
+            rows[r] = sum;
+        }
+        __m128 direction = _mm_add_ps(_mm_add_ps(
+            _mm_mul_ps(_mm_set1_ps(v.normal.x), rows[0]),
+            _mm_mul_ps(_mm_set1_ps(v.normal.y), rows[1])),
+            _mm_mul_ps(_mm_set1_ps(v.normal.z), rows[2]));
+        __m128 point = _mm_add_ps(_mm_add_ps(_mm_add_ps(
+            _mm_mul_ps(_mm_set1_ps(v.position.x), rows[0]),
+            _mm_mul_ps(_mm_set1_ps(v.position.y), rows[1])),
+            _mm_mul_ps(_mm_set1_ps(v.position.z), rows[2])), rows[3]);
+        float lanes[4];
+        _mm_storeu_ps(lanes, point);
+        v.position = {lanes[0], lanes[1], lanes[2]};
+        _mm_storeu_ps(lanes, direction);
+        v.normal = {lanes[0], lanes[1], lanes[2]};
+#else
+        Matrix4x4 blended;
+        for (int r = 0; r < 4; r++) {
+            for (int c = 0; c < 4; c++) {
+                blended.m[r][c] = s.weights[0] * palette[s.joints[0]].m[r][c] + s.weights[1] * palette[s.joints[1]].m[r][c] +
+                                  s.weights[2] * palette[s.joints[2]].m[r][c] + s.weights[3] * palette[s.joints[3]].m[r][c];
+            }
+        }
+        v.normal = MultiplyVectorDirection(v.normal, blended);
+        Vector3S p = v.position;
+        v.position = {
+            p.x * blended.m[0][0] + p.y * blended.m[1][0] + p.z * blended.m[2][0] + blended.m[3][0],
+            p.x * blended.m[0][1] + p.y * blended.m[1][1] + p.z * blended.m[2][1] + blended.m[3][1],
+            p.x * blended.m[0][2] + p.y * blended.m[1][2] + p.z * blended.m[2][2] + blended.m[3][2]
+        };
+#endif
+    }
+}
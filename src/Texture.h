@@ -3,12 +3,48 @@
 #include "MathS.h"
 #include <string>
 #include <cmath>
+#include <cstring>
+#include <cstdint>
+#include <atomic>
+#include <memory>
 #include <algorithm>
 
+// BC1 layout: two RGB565 endpoints, then 2-bit palette indices for the 4x4 texels, row-major
+static const int kTextureBlockSize = 4;
+static const int kBlockCacheEntries = 256;   // Per thread, direct-mapped; 8 KB
+
+// A block with its palette expanded: a texel is then one shift, mask and load. Kept
+// trivial so the thread_local cache is zero-initialized without a per-access guard.
+struct DecodedBlock {
+    uint32_t textureId;         // 0 never matches: ids start at 1
+    int blockIndex;
+    uint32_t indices;
+    Color palette[4];
+};
+
+// Blends four bilinear taps (c00 top-left, c10 right of it, c01 below it) at fraction (tx, ty)
+using BilinearFilterFn = Color (*)(Color c00, Color c10, Color c01, Color c11, float tx, float ty);
+
+inline Color BilinearFilter(Color c00, Color c10, Color c01, Color c11, float tx, float ty) {
+    return {
+        (unsigned char)((c00.r * (1-tx) + c10.r * tx) * (1-ty) + (c01.r * (1-tx) + c11.r * tx) * ty),
+        (unsigned char)((c00.g * (1-tx) + c10.g * tx) * (1-ty) + (c01.g * (1-tx) + c11.g * tx) * ty),
+        (unsigned char)((c00.b * (1-tx) + c10.b * tx) * (1-ty) + (c01.b * (1-tx) + c11.b * tx) * ty),
+        255
+    };
+}
+
+class VirtualTexture;
+
 struct TextureS {
     Color* pixels = nullptr;
+    uint64_t* blocks = nullptr;   // BC1 data when compressed; pixels is then null
+    // Paged from a tiled file instead (see VirtualTexture.h); pixels and blocks are then null
+    std::shared_ptr<VirtualTexture> virtualTexture;
     int width = 0;
     int height = 0;
+    int blocksX = 0;
+    uint32_t id = 0;              // Distinguishes textures in the decoded-block caches
 
     bool Load(const std::string& filepath) {
         Image img = LoadImage(filepath.c_str());
@@ -34,10 +70,55 @@ struct TextureS {
             delete[] pixels;
             pixels = nullptr;
         }
+        if (blocks) {
+            delete[] blocks;
+            blocks = nullptr;
+        }
+        virtualTexture.reset();
+    }
+
+    // Re-encodes the pixels as BC1 (8 bytes per 4x4 block, 8x smaller than RGBA8) and
+    // frees them. Alpha is dropped; the shaders never read it.
+    void Compress() {
+        if (!pixels) return;
+        blocksX = (width + kTextureBlockSize - 1) / kTextureBlockSize;
+        int blocksY = (height + kTextureBlockSize - 1) / kTextureBlockSize;
+        blocks = new uint64_t[blocksX * blocksY];
+
+        Color source[16];
+        for (int by = 0; by < blocksY; by++) {
+            for (int bx = 0; bx < blocksX; bx++) {
+                // Edge blocks repeat the last row/column
+                for (int i = 0; i < 16; i++) {
+                    int x = std::min(bx * 4 + (i & 3), width - 1);
+                    int y = std::min(by * 4 + (i >> 2), height - 1);
+                    source[i] = pixels[y * width + x];
+                }
+                blocks[by * blocksX + bx] = EncodeBlock(source);
+            }
+        }
+
+        delete[] pixels;
+        pixels = nullptr;
+        static std::atomic<uint32_t> nextId{1};
+        id = nextId++;
+    }
+
+    bool HasData() const { return pixels || blocks; }
+    bool IsCompressed() const { return blocks != nullptr; }
+
+    size_t GetMemoryBytes() const {
+        if (blocks) return (size_t)blocksX * ((height + 3) / 4) * sizeof(uint64_t);
+        return pixels ? (size_t)width * height * sizeof(Color) : 0;
+    }
+
+    Color Texel(int x, int y) const {
+        if (pixels) return pixels[y * width + x];
+        return BlockTexel(CachedBlock(x, y), x, y);
     }
 
     Color Sample(float u, float v) const {
-        if (!pixels) return WHITE;
+        if (!HasData()) return WHITE;
 
         u = u - floorf(u);
         v = v - floorf(v);
@@ -49,18 +130,18 @@ struct TextureS {
         x = std::max(0, std::min(width - 1, x));
         y = std::max(0, std::min(height - 1, y));
 
-        return pixels[y * width + x];
+        return Texel(x, y);
     }
 
-    Color SampleBilinear(float u, float v) const {
-        if (!pixels) return WHITE;
+    Color SampleBilinear(float u, float v, BilinearFilterFn filter = BilinearFilter) const {
+        if (!HasData()) return WHITE;
 
         u = u - floorf(u);
         v = 1.0f - (v - floorf(v));
 
         float fx = u * (width - 1);
         float fy = v * (height - 1);
-        
+
         int x0 = (int)fx;
         int y0 = (int)fy;
         int x1 = std::min(x0 + 1, width - 1);
@@ -69,16 +150,128 @@ struct TextureS {
         float tx = fx - x0;
         float ty = fy - y0;
 
-        Color c00 = pixels[y0 * width + x0];
-        Color c10 = pixels[y0 * width + x1];
-        Color c01 = pixels[y1 * width + x0];
-        Color c11 = pixels[y1 * width + x1];
-
-        return {
-            (unsigned char)((c00.r * (1-tx) + c10.r * tx) * (1-ty) + (c01.r * (1-tx) + c11.r * tx) * ty),
-            (unsigned char)((c00.g * (1-tx) + c10.g * tx) * (1-ty) + (c01.g * (1-tx) + c11.g * tx) * ty),
-            (unsigned char)((c00.b * (1-tx) + c10.b * tx) * (1-ty) + (c01.b * (1-tx) + c11.b * tx) * ty),
-            255
-        };
+        Color c00, c10, c01, c11;
+        if (blocks && (x0 >> 2) == (x1 >> 2) && (y0 >> 2) == (y1 >> 2)) {
+            // All four taps in one block: a single cache lookup
+            const DecodedBlock& block = CachedBlock(x0, y0);
+            c00 = BlockTexel(block, x0, y0);
+            c10 = BlockTexel(block, x1, y0);
+            c01 = BlockTexel(block, x0, y1);
+            c11 = BlockTexel(block, x1, y1);
+        } else {
+            c00 = Texel(x0, y0);
+            c10 = Texel(x1, y0);
+            c01 = Texel(x0, y1);
+            c11 = Texel(x1, y1);
+        }
+
+        return filter(c00, c10, c01, c11, tx, ty);
+    }
+
+private:
+    // Neighbouring bilinear taps and neighbouring pixels mostly hit the same block, so
+    // expand its palette once per thread and keep it
+    const DecodedBlock& CachedBlock(int x, int y) const {
+        static thread_local DecodedBlock cache[kBlockCacheEntries];
+        int blockIndex = (y >> 2) * blocksX + (x >> 2);
+        DecodedBlock& entry = cache[(blockIndex + id * 97) & (kBlockCacheEntries - 1)];
+        if (entry.textureId != id || entry.blockIndex != blockIndex) {
+            uint64_t block = blocks[blockIndex];
+            MakePalette((uint16_t)block, (uint16_t)(block >> 16), entry.palette);
+            entry.indices = (uint32_t)(block >> 32);
+            entry.textureId = id;
+            entry.blockIndex = blockIndex;
+        }
+        return entry;
+    }
+
+    static Color BlockTexel(const DecodedBlock& block, int x, int y) {
+        return block.palette[(block.indices >> (((y & 3) * 4 + (x & 3)) * 2)) & 3];
+    }
+
+    static uint16_t To565(float r, float g, float b) {
+        int r5 = std::max(0, std::min(31, (int)(r * 31.0f / 255.0f + 0.5f)));
+        int g6 = std::max(0, std::min(63, (int)(g * 63.0f / 255.0f + 0.5f)));
+        int b5 = std::max(0, std::min(31, (int)(b * 31.0f / 255.0f + 0.5f)));
+        return (uint16_t)((r5 << 11) | (g6 << 5) | b5);
+    }
+
+    static Color From565(uint16_t c) {
+        int r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+        return {(unsigned char)((r << 3) | (r >> 2)), (unsigned char)((g << 2) | (g >> 4)),
+                (unsigned char)((b << 3) | (b >> 2)), 255};
+    }
+
+    static void MakePalette(uint16_t c0, uint16_t c1, Color palette[4]) {
+        palette[0] = From565(c0);
+        palette[1] = From565(c1);
+        if (c0 > c1) {
+            palette[2] = {(unsigned char)((2 * palette[0].r + palette[1].r) / 3), (unsigned char)((2 * palette[0].g + palette[1].g) / 3),
+                          (unsigned char)((2 * palette[0].b + palette[1].b) / 3), 255};
+            palette[3] = {(unsigned char)((palette[0].r + 2 * palette[1].r) / 3), (unsigned char)((palette[0].g + 2 * palette[1].g) / 3),
+                          (unsigned char)((palette[0].b + 2 * palette[1].b) / 3), 255};
+        } else {
+            palette[2] = {(unsigned char)((palette[0].r + palette[1].r) / 2), (unsigned char)((palette[0].g + palette[1].g) / 2),
+                          (unsigned char)((palette[0].b + palette[1].b) / 2), 255};
+            palette[3] = {0, 0, 0, 255};
+        }
+    }
+
+    // Endpoints are the block's extremes along its principal colour axis; every texel then
+    // takes the nearest of the four palette entries
+    static uint64_t EncodeBlock(const Color texels[16]) {
+        float mean[3] = {0, 0, 0};
+        for (int i = 0; i < 16; i++) {
+            mean[0] += texels[i].r; mean[1] += texels[i].g; mean[2] += texels[i].b;
+        }
+        for (float& m : mean) m /= 16.0f;
+
+        float cov[6] = {0, 0, 0, 0, 0, 0};   // rr, rg, rb, gg, gb, bb
+        for (int i = 0; i < 16; i++) {
+            float r = texels[i].r - mean[0], g = texels[i].g - mean[1], b = texels[i].b - mean[2];
+            cov[0] += r * r; cov[1] += r * g; cov[2] += r * b;
+            cov[3] += g * g; cov[4] += g * b; cov[5] += b * b;
+        }
+
+        // A few power iterations are plenty for a 3x3 matrix
+        Vector3S axis = {1.0f, 1.0f, 1.0f};
+        for (int iteration = 0; iteration < 4; iteration++) {
+            Vector3S next = {
+                cov[0] * axis.x + cov[1] * axis.y + cov[2] * axis.z,
+                cov[1] * axis.x + cov[3] * axis.y + cov[4] * axis.z,
+                cov[2] * axis.x + cov[4] * axis.y + cov[5] * axis.z
+            };
+            float length = Vector3Length(next);
+            if (length < 1e-6f) break;
+            axis = Vector3Scale(next, 1.0f / length);
+        }
+
+        float minT = 0.0f, maxT = 0.0f;
+        for (int i = 0; i < 16; i++) {
+            float t = (texels[i].r - mean[0]) * axis.x + (texels[i].g - mean[1]) * axis.y + (texels[i].b - mean[2]) * axis.z;
+            minT = std::min(minT, t);
+            maxT = std::max(maxT, t);
+        }
+        uint16_t c0 = To565(mean[0] + axis.x * maxT, mean[1] + axis.y * maxT, mean[2] + axis.z * maxT);
+        uint16_t c1 = To565(mean[0] + axis.x * minT, mean[1] + axis.y * minT, mean[2] + axis.z * minT);
+        if (c0 < c1) std::swap(c0, c1);   // Four-colour mode needs c0 > c1
+        if (c0 == c1) return c0 | ((uint64_t)c1 << 16);   // Flat block: every index 0
+
+        Color palette[4];
+        MakePalette(c0, c1, palette);
+        uint32_t indices = 0;
+        for (int i = 0; i < 16; i++) {
+            int best = 0, bestError = INT32_MAX;
+            for (int p = 0; p < 4; p++) {
+                int dr = texels[i].r - palette[p].r, dg = texels[i].g - palette[p].g, db = texels[i].b - palette[p].b;
+                int error = dr * dr + dg * dg + db * db;
+                if (error < bestError) {
+                    bestError = error;
+                    best = p;
+                }
+            }
+            indices |= (uint32_t)best << (i * 2);
+        }
+        return c0 | ((uint64_t)c1 << 16) | ((uint64_t)indices << 32);
     }
-};
\ No newline at end of file
+};
@@ -1,11 +1,11 @@
 #pragma once
 #include <vector>
 #include <thread>
-#include <queue>
 #include <mutex>
 #include <condition_variable>
 #include <functional>
 #include <atomic>
+#include <algorithm>
 
 class ThreadPool {
 public:
@@ -29,7 +29,9 @@ public:
     void Enqueue(std::function<void()> task) {
         {
             std::unique_lock<std::mutex> lock(queueMutex);
-            tasks.push(std::move(task));
+            if (taskCount == tasks.size()) GrowQueue();
+            tasks[(taskHead + taskCount) % tasks.size()] = std::move(task);
+            taskCount++;
             activeJobs++;
         }
         condition.notify_one();
@@ -39,7 +41,7 @@ public:
         {
             std::unique_lock<std::mutex> lock(queueMutex);
             doneCondition.wait(lock, [this] {
-                return activeJobs == 0 && tasks.empty();
+                return activeJobs == 0 && taskCount == 0;
             });
         }
     }
@@ -52,15 +54,16 @@ private:
             {
                 std::unique_lock<std::mutex> lock(queueMutex);
                 condition.wait(lock, [this] {
-                    return stop || !tasks.empty();
+                    return stop || taskCount > 0;
                 });
 
-                if (stop && tasks.empty()) {
+                if (stop && taskCount == 0) {
                     return;
                 }
 
-                task = std::move(tasks.front());
-                tasks.pop();
+                task = std::move(tasks[taskHead]);
+                taskHead = (taskHead + 1) % tasks.size();
+                taskCount--;
             }
 
             task();
@@ -73,8 +76,20 @@ private:
         }
     }
 
+    // Unwraps the ring into a larger one; once it has seen the busiest frame it never grows again
+    void GrowQueue() {
+        std::vector<std::function<void()>> grown(std::max<size_t>(64, tasks.size() * 2));
+        for (size_t i = 0; i < taskCount; i++) {
+            grown[i] = std::move(tasks[(taskHead + i) % tasks.size()]);
+        }
+        tasks.swap(grown);
+        taskHead = 0;
+    }
+
     std::vector<std::thread> workers;
-    std::queue<std::function<void()>> tasks;
+    std::vector<std::function<void()>> tasks;   // Ring buffer of pending tasks
+    size_t taskHead = 0;
+    size_t taskCount = 0;
 
     std::mutex queueMutex;
     std::condition_variable condition;
@@ -0,0 +1,246 @@
+#pragma once
+#include "Components.h"
+#include "MathS.h"
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+static const int kCachedViews = 4;   // Views an object keeps an MVP for
+
+// One float per object of a batch of four
+struct Float4 {
+#if defined(__SSE2__)
+    __m128 v;
+    static Float4 Load(const float* p) { return {_mm_loadu_ps(p)}; }
+    void Store(float* p) const { _mm_storeu_ps(p, v); }
+    friend Float4 operator+(Float4 a, Float4 b) { return {_mm_add_ps(a.v, b.v)}; }
+    friend Float4 operator-(Float4 a, Float4 b) { return {_mm_sub_ps(a.v, b.v)}; }
+    friend Float4 operator*(Float4 a, Float4 b) { return {_mm_mul_ps(a.v, b.v)}; }
+    friend Float4 operator/(Float4 a, Float4 b) { return {_mm_div_ps(a.v, b.v)}; }
+    friend Float4 operator-(Float4 a) { return {_mm_xor_ps(a.v, _mm_set1_ps(-0.0f))}; }
+    static Float4 Splat(float f) { return {_mm_set1_ps(f)}; }
+#else
+    float v[4];
+    static Float4 Load(const float* p) { Float4 r; memcpy(r.v, p, sizeof(r.v)); return r; }
+    void Store(float* p) const { memcpy(p, v, sizeof(v)); }
+    template <typename Op>
+    static Float4 Apply(Float4 a, Float4 b, Op op) { return {{op(a.v[0], b.v[0]), op(a.v[1], b.v[1]), op(a.v[2], b.v[2]), op(a.v[3], b.v[3])}}; }
+    friend Float4 operator+(Float4 a, Float4 b) { return Apply(a, b, [](float x, float y) { return x + y; }); }
+    friend Float4 operator-(Float4 a, Float4 b) { return Apply(a, b, [](float x, float y) { return x - y; }); }
+    friend Float4 operator*(Float4 a, Float4 b) { return Apply(a, b, [](float x, float y) { return x * y; }); }
+    friend Float4 operator/(Float4 a, Float4 b) { return Apply(a, b, [](float x, float y) { return x / y; }); }
+    friend Float4 operator-(Float4 a) { return {{-a.v[0], -a.v[1], -a.v[2], -a.v[3]}}; }
+    static Float4 Splat(float f) { return {{f, f, f, f}}; }
+#endif
+};
+
+// An object's MVP for one view, valid while both versions still match
+struct CachedMVP {
+    Matrix4x4 mvp;
+    uint32_t version = 0;        // Transform version it was built from
+    uint32_t viewVersion = 0;
+};
+
+// Object transforms in structure-of-arrays form. Setters only mark a transform dirty;
+// Update then rebuilds the world and normal matrices of dirty transforms four at a time,
+// so unchanged objects cost nothing per frame.
+class TransformSystem {
+public:
+    uint32_t Create(const TransformS& transform = TransformS()) {
+        uint32_t id;
+        if (!freeIds.empty()) {
+            id = freeIds.back();
+            freeIds.pop_back();
+        } else {
+            id = (uint32_t)versions.size();
+            // Arrays grow a whole batch at a time so Update never reads past the end
+            if (id % 4 == 0) {
+                for (std::vector<float>* column : {&posX, &posY, &posZ, &rotX, &rotY, &rotZ, &scaleX, &scaleY, &scaleZ}) {
+                    column->resize(id + 4, 0.0f);
+                }
+                dirty.resize(id + 4, 0);
+                world.resize(id + 4, Matrix4x4::Identity());
+                normal.resize(id + 4, Matrix4x4::Identity());
+                mvps.resize((id + 4) * kCachedViews);
+            }
+            versions.push_back(0);
+        }
+        Set(id, transform);
+        return id;
+    }
+
+    void Destroy(uint32_t id) {
+        dirty[id] = 0;
+        versions[id]++;    // Invalidates cached MVPs if the id is reused
+        freeIds.push_back(id);
+    }
+
+    void Set(uint32_t id, const TransformS& transform) {
+        SetPosition(id, transform.position);
+        SetRotation(id, transform.rotation);
+        SetScale(id, transform.scale);
+    }
+
+    void SetPosition(uint32_t id, Vector3S v) { posX[id] = v.x; posY[id] = v.y; posZ[id] = v.z; MarkDirty(id); }
+    void SetRotation(uint32_t id, Vector3S v) { rotX[id] = v.x; rotY[id] = v.y; rotZ[id] = v.z; MarkDirty(id); }
+    void SetScale(uint32_t id, Vector3S v) { scaleX[id] = v.x; scaleY[id] = v.y; scaleZ[id] = v.z; MarkDirty(id); }
+
+    Vector3S GetPosition(uint32_t id) const { return {posX[id], posY[id], posZ[id]}; }
+    Vector3S GetRotation(uint32_t id) const { return {rotX[id], rotY[id], rotZ[id]}; }
+    Vector3S GetScale(uint32_t id) const { return {scaleX[id], scaleY[id], scaleZ[id]}; }
+    TransformS Get(uint32_t id) const { return {GetPosition(id), GetRotation(id), GetScale(id)}; }
+
+    bool HasChanges() const { return anyDirty; }
+
+    // Rebuilds world and normal matrices for every dirty transform
+    void Update() {
+        if (!anyDirty) return;
+        anyDirty = false;
+        for (size_t base = 0; base < dirty.size(); base += 4) {
+            uint32_t batchDirty;
+            memcpy(&batchDirty, &dirty[base], sizeof(batchDirty));
+            if (batchDirty == 0) continue;
+            UpdateBatch(base);
+            for (size_t i = base; i < base + 4; i++) {
+                if (!dirty[i]) continue;
+                dirty[i] = 0;
+                versions[i]++;
+            }
+        }
+    }
+
+    const Matrix4x4& GetWorld(uint32_t id) const { return world[id]; }
+    const Matrix4x4& GetNormal(uint32_t id) const { return normal[id]; }
+    // Changes whenever the world matrix does
+    uint32_t GetVersion(uint32_t id) const { return versions[id]; }
+
+    // world * view * proj, rebuilt only when the transform or the view changed. viewVersion
+    // must be unique to the view/proj pair. Main thread only.
+    const Matrix4x4& GetMVP(uint32_t id, int viewSlot, uint32_t viewVersion, const Matrix4x4& view, const Matrix4x4& proj) {
+        CachedMVP& cached = mvps[id * kCachedViews + viewSlot];
+        if (cached.version != versions[id] || cached.viewVersion != viewVersion) {
+            cached.mvp = MultiplyMatrix(MultiplyMatrix(world[id], view), proj);
+            cached.version = versions[id];
+            cached.viewVersion = viewVersion;
+        }
+        return cached.mvp;
+    }
+
+private:
+    void MarkDirty(uint32_t id) {
+        dirty[id] = 1;
+        anyDirty = true;
+    }
+
+    // Four transforms at once. The entries are exactly what the scale * rotZ * rotX *
+    // rotY * translation chain of full matrix products evaluates to, with the products
+    // against zero and one left out, so the result matches it bit for bit.
+    void UpdateBatch(size_t base) {
+        float sines[3][4], cosines[3][4];
+        for (int lane = 0; lane < 4; lane++) {
+            sines[0][lane] = sinf(rotX[base + lane]); cosines[0][lane] = cosf(rotX[base + lane]);
+            sines[1][lane] = sinf(rotY[base + lane]); cosines[1][lane] = cosf(rotY[base + lane]);
+            sines[2][lane] = sinf(rotZ[base + lane]); cosines[2][lane] = cosf(rotZ[base + lane]);
+        }
+        Float4 sx = Float4::Load(&scaleX[base]), sy = Float4::Load(&scaleY[base]), sz = Float4::Load(&scaleZ[base]);
+        Float4 snX = Float4::Load(sines[0]), csX = Float4::Load(cosines[0]);
+        Float4 snY = Float4::Load(sines[1]), csY = Float4::Load(cosines[1]);
+        Float4 snZ = Float4::Load(sines[2]), csZ = Float4::Load(cosines[2]);
+
+        // scale * rotZ
+        Float4 a00 = sx * csZ, a01 = sx * snZ;
+        Float4 a10 = sy * -snZ, a11 = sy * csZ;
+        Float4 a22 = sz;
+        // * rotX
+        Float4 b01 = a01 * csX, b02 = a01 * snX;
+        Float4 b11 = a11 * csX, b12 = a11 * snX;
+        Float4 b21 = a22 * -snX, b22 = a22 * csX;
+        // * rotY; translation only fills the last row
+        Float4 w[3][3] = {
+            {a00 * csY + b02 * -snY, b01, a00 * snY + b02 * csY},
+            {a10 * csY + b12 * -snY, b11, a10 * snY + b12 * csY},
+            {b22 * -snY, b21, b22 * csY}
+        };
+
+        // Inverse transpose of the upper 3x3, as MatrixInverseTranspose3x3 computes it
+        Float4 a = w[0][0], b = w[0][1], c = w[0][2];
+        Float4 d = w[1][0], e = w[1][1], f = w[1][2];
+        Float4 g = w[2][0], h = w[2][1], i = w[2][2];
+        Float4 det = a * (e * i - f * h) - b * (d * i - f * g) + c * (d * h - e * g);
+        Float4 invDet = Float4::Splat(1.0f) / det;
+        Float4 n[3][3] = {
+            {(e * i - f * h) * invDet, -(d * i - f * g) * invDet, (d * h - e * g) * invDet},
+            {-(b * i - c * h) * invDet, (a * i - c * g) * invDet, -(a * h - b * g) * invDet},
+            {(b * f - c * e) * invDet, -(a * f - c * d) * invDet, (a * e - b * d) * invDet}
+        };
+
+        float worldLanes[3][3][4], normalLanes[3][3][4], detLanes[4];
+        for (int r = 0; r < 3; r++) {
+            for (int col = 0; col < 3; col++) {
+                w[r][col].Store(worldLanes[r][col]);
+                n[r][col].Store(normalLanes[r][col]);
+            }
+        }
+        det.Store(detLanes);
+
+        for (int lane = 0; lane < 4; lane++) {
+            size_t id = base + lane;
+            if (!dirty[id]) continue;
+            Matrix4x4& out = world[id];
+            Matrix4x4& outNormal = normal[id];
+            out = Matrix4x4::Identity();
+            outNormal = Matrix4x4::Identity();
+            bool singular = fabsf(detLanes[lane]) < 1e-8f;
+            for (int r = 0; r < 3; r++) {
+                for (int col = 0; col < 3; col++) {
+                    out.m[r][col] = worldLanes[r][col][lane];
+                    if (!singular) outNormal.m[r][col] = normalLanes[r][col][lane];
+                }
+            }
+            out.m[3][0] = posX[id];
+            out.m[3][1] = posY[id];
+            out.m[3][2] = posZ[id];
+        }
+    }
+
+    std::vector<float> posX, posY, posZ;
+    std::vector<float> rotX, rotY, rotZ;
+    std::vector<float> scaleX, scaleY, scaleZ;
+    std::vector<uint8_t> dirty;
+    std::vector<uint32_t> versions;
+    std::vector<Matrix4x4> world;
+    std::vector<Matrix4x4> normal;
+    std::vector<CachedMVP> mvps;         // kCachedViews per transform
+    std::vector<uint32_t> freeIds;
+    bool anyDirty = false;
+};
+
+// What a GameObject holds: its slot in a TransformSystem
+class TransformHandle {
+public:
+    TransformHandle(TransformSystem& system, const TransformS& transform = TransformS())
+        : system(&system), id(system.Create(transform)) {}
+    ~TransformHandle() { system->Destroy(id); }
+    TransformHandle(const TransformHandle&) = delete;
+    TransformHandle& operator=(const TransformHandle&) = delete;
+
+    void Set(const TransformS& transform) { system->Set(id, transform); }
+    void SetPosition(Vector3S v) { system->SetPosition(id, v); }
+    void SetRotation(Vector3S v) { system->SetRotation(id, v); }
+    void SetScale(Vector3S v) { system->SetScale(id, v); }
+    Vector3S GetPosition() const { return system->GetPosition(id); }
+    Vector3S GetRotation() const { return system->GetRotation(id); }
+    Vector3S GetScale() const { return system->GetScale(id); }
+
+    TransformSystem& GetSystem() const { return *system; }
+    uint32_t GetId() const { return id; }
+
+private:
+    TransformSystem* system;
+    uint32_t id;
+};
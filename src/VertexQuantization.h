@@ -0,0 +1,183 @@
+#pragma once
+#include "Components.h"
+#include "MathS.h"
+#include "Meshlets.h"
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+// How AssetManager packs the meshes it loads
+struct VertexQuantization {
+    bool enabled = false;
+    NormalEncoding normals = NormalEncoding::Oct16;
+    UVEncoding uvs = UVEncoding::Unorm16;
+};
+
+// Round to nearest, ties away from zero; no NaN handling, as attributes never hold NaN
+inline uint16_t FloatToHalf(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint32_t sign = (bits >> 16) & 0x8000;
+    int exponent = (int)((bits >> 23) & 0xFF) - 127 + 15;
+    uint32_t mantissa = bits & 0x7FFFFF;
+    if (exponent >= 31) return (uint16_t)(sign | 0x7C00);
+    if (exponent <= 0) {
+        // Subnormal half
+        if (exponent < -10) return (uint16_t)sign;
+        mantissa |= 0x800000;
+        int shift = 14 - exponent;
+        uint32_t half = mantissa >> shift;
+        if ((mantissa >> (shift - 1)) & 1) half++;
+        return (uint16_t)(sign | half);
+    }
+    uint32_t half = sign | ((uint32_t)exponent << 10) | (mantissa >> 13);
+    if (mantissa & 0x1000) half++;   // A carry into the exponent is still the right value
+    return (uint16_t)half;
+}
+
+inline float HalfToFloat(uint16_t half) {
+    uint32_t sign = (uint32_t)(half & 0x8000) << 16;
+    uint32_t exponent = (half >> 10) & 0x1F;
+    uint32_t mantissa = half & 0x3FF;
+    if (exponent == 0) {
+        float value = mantissa * (1.0f / 16777216.0f);
+        return sign ? -value : value;
+    }
+    uint32_t bits = exponent == 31 ? sign | 0x7F800000 | (mantissa << 13) : sign | ((exponent + 112) << 23) | (mantissa << 13);
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// Unit vector onto the octahedron, unfolded into [-1, 1]^2
+inline Vector2S EncodeOctahedral(const Vector3S& n) {
+    float sum = std::fabs(n.x) + std::fabs(n.y) + std::fabs(n.z);
+    if (sum == 0.0f) return {0.0f, 0.0f};
+    float x = n.x / sum, y = n.y / sum;
+    if (n.z < 0.0f) {
+        float foldedX = (1.0f - std::fabs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+        float foldedY = (1.0f - std::fabs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+        x = foldedX;
+        y = foldedY;
+    }
+    return {x, y};
+}
+
+// Not unit length: VertexShader normalizes after the normal matrix anyway
+inline Vector3S DecodeOctahedral(float x, float y) {
+    float z = 1.0f - std::fabs(x) - std::fabs(y);
+    if (z < 0.0f) {
+        float unfoldedX = (1.0f - std::fabs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+        float unfoldedY = (1.0f - std::fabs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+        x = unfoldedX;
+        y = unfoldedY;
+    }
+    return {x, y, z};
+}
+
+inline Vector3S DecodePackedPosition(const PackedVertices& packed, uint32_t index) {
+    const uint16_t* q = &packed.positions[index * 3];
+    return {
+        packed.positionMin.x + q[0] * packed.positionScale.x,
+        packed.positionMin.y + q[1] * packed.positionScale.y,
+        packed.positionMin.z + q[2] * packed.positionScale.z
+    };
+}
+
+inline Vector3S DecodePackedNormal(const PackedVertices& packed, uint32_t index) {
+    if (packed.normalEncoding == NormalEncoding::Oct8) {
+        const int8_t* q = (const int8_t*)&packed.normals[index * 2];
+        return DecodeOctahedral(q[0] * (1.0f / 127.0f), q[1] * (1.0f / 127.0f));
+    }
+    int16_t q[2];
+    memcpy(q, &packed.normals[index * 4], sizeof(q));
+    return DecodeOctahedral(q[0] * (1.0f / 32767.0f), q[1] * (1.0f / 32767.0f));
+}
+
+inline Vector2S DecodePackedUV(const PackedVertices& packed, uint32_t index) {
+    const uint16_t* q = &packed.uvs[index * 2];
+    if (packed.uvEncoding == UVEncoding::Half) return {HalfToFloat(q[0]), HalfToFloat(q[1])};
+    return {packed.uvMin.x + q[0] * packed.uvScale.x, packed.uvMin.y + q[1] * packed.uvScale.y};
+}
+
+inline Vertex DecodePackedVertex(const PackedVertices& packed, uint32_t index) {
+    return {DecodePackedPosition(packed, index), DecodePackedNormal(packed, index), DecodePackedUV(packed, index)};
+}
+
+// Takes quantized positions, as floats, to object space: folded into a world or MVP
+// matrix, it dequantizes inside the vertex transform for free
+inline Matrix4x4 PackedPositionMatrix(const PackedVertices& packed) {
+    Matrix4x4 m = MatrixMakeScale(packed.positionScale.x, packed.positionScale.y, packed.positionScale.z);
+    m.m[3][0] = packed.positionMin.x;
+    m.m[3][1] = packed.positionMin.y;
+    m.m[3][2] = packed.positionMin.z;
+    return m;
+}
+
+// Unorm16 over [lo, lo + 65535 * scale]
+static inline uint16_t QuantizeUnorm16(float value, float lo, float scale) {
+    if (scale <= 0.0f) return 0;
+    return (uint16_t)std::max(0.0f, std::min(65535.0f, std::round((value - lo) / scale)));
+}
+
+// Replaces the mesh's float vertices with packed streams: 12 bytes a vertex with Oct8
+// normals, 14 with Oct16, against 32. Meshlet bounds are refitted to the positions the
+// renderer will decode, so culling stays conservative. Skinned and morphed meshes are
+// left alone, as the deform stage works on float vertices; returns false for those.
+inline bool QuantizeVertices(MeshS& mesh, NormalEncoding normalEncoding = NormalEncoding::Oct16,
+                             UVEncoding uvEncoding = UVEncoding::Unorm16) {
+    if (mesh.vertices.empty() || !mesh.skin.empty() || !mesh.morphTargets.empty()) return false;
+    size_t count = mesh.vertices.size();
+
+    Vector3S lo = mesh.vertices[0].position, hi = lo;
+    Vector2S uvLo = mesh.vertices[0].uv, uvHi = uvLo;
+    for (const Vertex& v : mesh.vertices) {
+        lo = {std::min(lo.x, v.position.x), std::min(lo.y, v.position.y), std::min(lo.z, v.position.z)};
+        hi = {std::max(hi.x, v.position.x), std::max(hi.y, v.position.y), std::max(hi.z, v.position.z)};
+        uvLo = {std::min(uvLo.x, v.uv.x), std::min(uvLo.y, v.uv.y)};
+        uvHi = {std::max(uvHi.x, v.uv.x), std::max(uvHi.y, v.uv.y)};
+    }
+
+    PackedVertices& packed = mesh.packed;
+    packed.normalEncoding = normalEncoding;
+    packed.uvEncoding = uvEncoding;
+    packed.positionMin = lo;
+    packed.positionScale = Vector3Scale(Vector3Sub(hi, lo), 1.0f / 65535.0f);
+    packed.uvMin = uvLo;
+    packed.uvScale = {(uvHi.x - uvLo.x) / 65535.0f, (uvHi.y - uvLo.y) / 65535.0f};
+    packed.positions.resize(count * 3);
+    packed.normals.resize(count * (normalEncoding == NormalEncoding::Oct8 ? 2 : 4));
+    packed.uvs.resize(count * 2);
+
+    for (size_t i = 0; i < count; i++) {
+        Vertex& v = mesh.vertices[i];
+        packed.positions[i * 3] = QuantizeUnorm16(v.position.x, lo.x, packed.positionScale.x);
+        packed.positions[i * 3 + 1] = QuantizeUnorm16(v.position.y, lo.y, packed.positionScale.y);
+        packed.positions[i * 3 + 2] = QuantizeUnorm16(v.position.z, lo.z, packed.positionScale.z);
+        v.position = DecodePackedPosition(packed, (uint32_t)i);
+
+        Vector2S oct = EncodeOctahedral(v.normal);
+        if (normalEncoding == NormalEncoding::Oct8) {
+            int8_t q[2] = {(int8_t)std::round(oct.x * 127.0f), (int8_t)std::round(oct.y * 127.0f)};
+            memcpy(&packed.normals[i * 2], q, sizeof(q));
+        } else {
+            int16_t q[2] = {(int16_t)std::round(oct.x * 32767.0f), (int16_t)std::round(oct.y * 32767.0f)};
+            memcpy(&packed.normals[i * 4], q, sizeof(q));
+        }
+
+        if (uvEncoding == UVEncoding::Half) {
+            packed.uvs[i * 2] = FloatToHalf(v.uv.x);
+            packed.uvs[i * 2 + 1] = FloatToHalf(v.uv.y);
+        } else {
+            packed.uvs[i * 2] = QuantizeUnorm16(v.uv.x, uvLo.x, packed.uvScale.x);
+            packed.uvs[i * 2 + 1] = QuantizeUnorm16(v.uv.y, uvLo.y, packed.uvScale.y);
+        }
+    }
+
+    UpdateMeshletBounds(mesh);
+    std::vector<Vertex>().swap(mesh.vertices);
+    packed.count = (uint32_t)count;
+    return true;
+}
@@ -0,0 +1,421 @@
+#pragma once
+#include "raylib.h"
+#include "Texture.h"
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <atomic>
+#include <cstdio>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+
+#ifndef __EMSCRIPTEN__
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#endif
+
+static const int kVirtualPageSize = 128;            // Texels per page side in files Build writes
+static const int kVirtualPagesInFlight = 32;        // Page reads queued at once
+static const uint32_t kVirtualTextureMagic = 0x58455456;   // "VTEX"
+static const uint32_t kVirtualTextureVersion = 1;
+
+// Tiled file layout: this header, then every page of mip 0 row-major, then mip 1's and
+// so on. Pages are pageSize^2 RGBA8 texels; edge pages repeat the last row/column. The
+// chain stops at the first mip that fits in one page, which stays resident.
+struct VirtualTextureHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t width, height;
+    uint32_t pageSize;
+    uint32_t mipCount;
+};
+
+inline bool IsVirtualTexturePath(const std::string& path) {
+    return path.size() > 5 && path.compare(path.size() - 5, 5, ".vtex") == 0;
+}
+
+// A texture too large to keep decoded, paged in as it is seen. Raster marks every page it
+// samples, the wanted mip's page included when it falls back to a coarser resident one;
+// Update turns those marks into LRU order and page reads, which a loader thread services
+// into a cache of at most cachePages pages. Memory follows what is visible, not the file.
+class VirtualTexture {
+public:
+    // Cuts an image into a tiled file with its mip chain; false if either file fails.
+    // pageSize must be a power of two.
+    static bool Build(const std::string& imagePath, const std::string& path, int pageSize = kVirtualPageSize) {
+        if (pageSize <= 0 || (pageSize & (pageSize - 1))) return false;
+        TextureS source;
+        if (!source.Load(imagePath)) return false;
+        FILE* file = fopen(path.c_str(), "wb");
+        if (!file) {
+            source.Unload();
+            return false;
+        }
+
+        std::vector<Color> mip(source.pixels, source.pixels + source.width * source.height);
+        source.Unload();
+        int width = source.width, height = source.height;
+        std::vector<std::vector<Color>> chain;
+        std::vector<std::pair<int, int>> sizes;
+        while (true) {
+            chain.push_back(mip);
+            sizes.push_back({width, height});
+            if (width <= pageSize && height <= pageSize) break;
+            mip = Downsample(mip, width, height);
+            width = std::max(1, width / 2);
+            height = std::max(1, height / 2);
+        }
+
+        VirtualTextureHeader header = {kVirtualTextureMagic, kVirtualTextureVersion, (uint32_t)sizes[0].first,
+                                       (uint32_t)sizes[0].second, (uint32_t)pageSize, (uint32_t)chain.size()};
+        bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+        std::vector<Color> page((size_t)pageSize * pageSize);
+        for (size_t level = 0; level < chain.size() && ok; level++) {
+            int w = sizes[level].first, h = sizes[level].second;
+            for (int py = 0; py * pageSize < h && ok; py++) {
+                for (int px = 0; px * pageSize < w && ok; px++) {
+                    for (int y = 0; y < pageSize; y++) {
+                        int sy = std::min(py * pageSize + y, h - 1);
+                        for (int x = 0; x < pageSize; x++) {
+                            int sx = std::min(px * pageSize + x, w - 1);
+                            page[y * pageSize + x] = chain[level][sy * w + sx];
+                        }
+                    }
+                    ok = fwrite(page.data(), sizeof(Color), page.size(), file) == page.size();
+                }
+            }
+        }
+        return fclose(file) == 0 && ok;
+    }
+
+    // Opens a tiled file and reads its resident tail page; null if the file is unusable
+    static std::unique_ptr<VirtualTexture> Open(const std::string& path, int cachePages) {
+        FILE* file = fopen(path.c_str(), "rb");
+        if (!file) return nullptr;
+        VirtualTextureHeader header;
+        if (fread(&header, sizeof(header), 1, file) != 1 || header.magic != kVirtualTextureMagic ||
+            header.version != kVirtualTextureVersion || header.pageSize == 0 || (header.pageSize & (header.pageSize - 1)) ||
+            header.pageSize > 4096 || header.mipCount == 0 || header.mipCount > 32 ||
+            header.width == 0 || header.height == 0) {
+            fclose(file);
+            return nullptr;
+        }
+        std::unique_ptr<VirtualTexture> texture(new VirtualTexture(file, header, std::max(2, cachePages)));
+        int tail = texture->pageCount - 1;
+        std::vector<Color> texels;
+        if (!texture->ReadPage(tail, texels)) return nullptr;
+        texture->pinnedSlot = texture->AllocateSlot();
+        texture->StorePage(texture->pinnedSlot, tail, texels);
+        texture->Unlink(texture->pinnedSlot);    // Never evicted
+#ifndef __EMSCRIPTEN__
+        texture->loader = std::thread(&VirtualTexture::LoaderLoop, texture.get());
+#endif
+        return texture;
+    }
+
+    ~VirtualTexture() {
+#ifndef __EMSCRIPTEN__
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            stopping = true;
+        }
+        queueCondition.notify_all();
+        if (loader.joinable()) loader.join();
+#endif
+        fclose(file);
+    }
+
+    VirtualTexture(const VirtualTexture&) = delete;
+    VirtualTexture& operator=(const VirtualTexture&) = delete;
+
+    int GetWidth() const { return levels[0].width; }
+    int GetHeight() const { return levels[0].height; }
+    int GetPageCount() const { return pageCount; }
+    int GetResidentPages() const { return residentPages; }
+    size_t GetMemoryBytes() const { return slotTexels.size() * pageTexels * sizeof(Color); }
+    // Changes whenever Update publishes pages, i.e. whenever the sampled image may change
+    uint32_t GetVersion() const { return version; }
+
+    // Bilinear at the mip nearest lod (log2 of mip-0 texels per pixel), or at the finest
+    // coarser mip that is resident. Safe from any number of raster threads.
+    Color Sample(float u, float v, float lod, BilinearFilterFn filter) const {
+        u = u - floorf(u);
+        v = 1.0f - (v - floorf(v));
+        int wanted = std::max(0, std::min((int)levels.size() - 1, (int)floorf(lod + 0.5f)));
+
+        for (int level = wanted; level < (int)levels.size(); level++) {
+            const Level& mip = levels[level];
+            float fx = u * (mip.width - 1);
+            float fy = v * (mip.height - 1);
+            int x0 = (int)fx;
+            int y0 = (int)fy;
+            int x1 = std::min(x0 + 1, mip.width - 1);
+            int y1 = std::min(y0 + 1, mip.height - 1);
+
+            // One page in the usual case; up to four where the taps straddle page edges
+            bool crossX = (x0 >> pageShift) != (x1 >> pageShift);
+            bool crossY = (y0 >> pageShift) != (y1 >> pageShift);
+            const Color* p00 = PageTexels(level, x0, y0);
+            const Color* p10 = crossX ? PageTexels(level, x1, y0) : p00;
+            const Color* p01 = crossY ? PageTexels(level, x0, y1) : p00;
+            const Color* p11 = crossX && crossY ? PageTexels(level, x1, y1) : (crossX ? p10 : p01);
+            if (!p00 || !p10 || !p01 || !p11) continue;
+
+            return filter(p00[PageOffset(x0, y0)], p10[PageOffset(x1, y0)], p01[PageOffset(x0, y1)],
+                          p11[PageOffset(x1, y1)], fx - x0, fy - y0);
+        }
+        return WHITE;   // Unreachable: the last mip is always resident
+    }
+
+    // Call on the main thread while nothing samples, once per frame: the marks raster left
+    // since the last call refresh the LRU order, finished reads are published into free or
+    // least recently used slots, and marked pages not resident are queued, coarse mips
+    // first so the fallback improves quickly. Pages marked this frame are never evicted;
+    // when they alone fill the cache, new pages wait.
+    void Update() {
+        for (int page = 0; page < pageCount; page++) {
+            if (IsMarked(page) && pageSlots[page] >= 0 &&
+                pageSlots[page] != pinnedSlot) {
+                Touch(pageSlots[page]);
+            }
+        }
+
+        std::vector<std::pair<int, std::vector<Color>>>& loaded = publishing;
+#ifndef __EMSCRIPTEN__
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            loaded.swap(completed);
+        }
+#else
+        // No loader thread: read this frame's share of the queue here
+        for (int i = 0; i < kVirtualPagesInFlight / 4 && !requests.empty(); i++) {
+            int page = requests.front();
+            requests.pop_front();
+            loaded.emplace_back(page, std::vector<Color>());
+            LoadPage(page, loaded.back().second);
+        }
+#endif
+        bool published = false;
+        for (auto& page : loaded) {
+            inFlight[page.first] = false;
+            inFlightCount--;
+            int slot = AllocateSlot();
+            if (slot < 0) continue;    // Dropped; marked again if it is still wanted
+            StorePage(slot, page.first, page.second);
+            published = true;
+        }
+        loaded.clear();
+        if (published) version++;
+
+        // A cache full of this frame's pages would only drop what is read
+        bool saturated = (int)slotTexels.size() == capacity && (lruTail < 0 || IsMarked(slotPages[lruTail]));
+        for (int level = (int)levels.size() - 1; level >= 0 && !saturated; level--) {
+            const Level& mip = levels[level];
+            for (int page = mip.firstPage; page < mip.firstPage + mip.pagesX * mip.pagesY && inFlightCount < kVirtualPagesInFlight; page++) {
+                if (!IsMarked(page) || pageSlots[page] >= 0 || inFlight[page]) continue;
+                inFlight[page] = true;
+                inFlightCount++;
+#ifndef __EMSCRIPTEN__
+                {
+                    std::unique_lock<std::mutex> lock(queueMutex);
+                    requests.push_back(page);
+                }
+                queueCondition.notify_one();
+#else
+                requests.push_back(page);
+#endif
+            }
+        }
+        markStamp++;
+    }
+
+private:
+    struct Level {
+        int width, height;
+        int pagesX, pagesY;
+        int firstPage;          // Global index of its first page
+    };
+
+    VirtualTexture(FILE* file, const VirtualTextureHeader& header, int cachePages)
+        : file(file), pageSize((int)header.pageSize), capacity(cachePages) {
+        pageTexels = (size_t)pageSize * pageSize;
+        pageShift = 0;
+        while ((1 << pageShift) < pageSize) pageShift++;
+        pageMask = pageSize - 1;
+        int width = (int)header.width, height = (int)header.height;
+        for (uint32_t level = 0; level < header.mipCount; level++) {
+            Level mip = {width, height, (width + pageSize - 1) / pageSize, (height + pageSize - 1) / pageSize, pageCount};
+            levels.push_back(mip);
+            pageCount += mip.pagesX * mip.pagesY;
+            width = std::max(1, width / 2);
+            height = std::max(1, height / 2);
+        }
+        pageSlots.assign(pageCount, -1);
+        inFlight.assign(pageCount, false);
+        marks.reset(new std::atomic<uint32_t>[pageCount]);
+        for (int page = 0; page < pageCount; page++) {
+            marks[page].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    int PageOf(int level, int x, int y) const {
+        const Level& mip = levels[level];
+        return mip.firstPage + (y >> pageShift) * mip.pagesX + (x >> pageShift);
+    }
+
+    int PageOffset(int x, int y) const {
+        return ((y & pageMask) << pageShift) + (x & pageMask);
+    }
+
+    // Marks the page for Update and returns its texels if resident. The load before the
+    // store keeps a page's cache line shared while every sample of a frame marks it.
+    const Color* PageTexels(int level, int x, int y) const {
+        int page = PageOf(level, x, y);
+        std::atomic<uint32_t>& mark = marks[page];
+        if (mark.load(std::memory_order_relaxed) != markStamp) mark.store(markStamp, std::memory_order_relaxed);
+        int slot = pageSlots[page];
+        return slot >= 0 ? slotTexels[slot].get() : nullptr;
+    }
+
+    // Sampled since the last Update
+    bool IsMarked(int page) const {
+        return marks[page].load(std::memory_order_relaxed) == markStamp;
+    }
+
+    bool ReadPage(int page, std::vector<Color>& texels) {
+        texels.resize(pageTexels);
+        long offset = (long)sizeof(VirtualTextureHeader) + (long)page * (long)(pageTexels * sizeof(Color));
+        return fseek(file, offset, SEEK_SET) == 0 && fread(texels.data(), sizeof(Color), pageTexels, file) == pageTexels;
+    }
+
+    // A page that fails to read is published magenta: it stands out, and is not retried
+    // every frame
+    void LoadPage(int page, std::vector<Color>& texels) {
+        if (!ReadPage(page, texels)) texels.assign(pageTexels, Color{255, 0, 255, 255});
+    }
+
+    // A free slot, growing the cache up to capacity, else the least recently used one
+    // unless it was marked this frame; -1 if there is none
+    int AllocateSlot() {
+        if ((int)slotTexels.size() < capacity) {
+            int slot = (int)slotTexels.size();
+            slotTexels.emplace_back(new Color[pageTexels]);
+            slotPages.push_back(-1);
+            lruPrev.push_back(-1);
+            lruNext.push_back(-1);
+            PushFront(slot);
+            return slot;
+        }
+        int slot = lruTail;
+        if (slot < 0 || IsMarked(slotPages[slot])) return -1;
+        pageSlots[slotPages[slot]] = -1;
+        residentPages--;
+        Touch(slot);
+        return slot;
+    }
+
+    void StorePage(int slot, int page, const std::vector<Color>& texels) {
+        std::copy(texels.begin(), texels.end(), slotTexels[slot].get());
+        slotPages[slot] = page;
+        pageSlots[page] = slot;
+        residentPages++;
+    }
+
+    // Slots form a list, most recently used at the head
+    void Unlink(int slot) {
+        if (lruPrev[slot] >= 0) lruNext[lruPrev[slot]] = lruNext[slot];
+        else if (lruHead == slot) lruHead = lruNext[slot];
+        if (lruNext[slot] >= 0) lruPrev[lruNext[slot]] = lruPrev[slot];
+        else if (lruTail == slot) lruTail = lruPrev[slot];
+        lruPrev[slot] = lruNext[slot] = -1;
+    }
+
+    void PushFront(int slot) {
+        lruNext[slot] = lruHead;
+        if (lruHead >= 0) lruPrev[lruHead] = slot;
+        lruHead = slot;
+        if (lruTail < 0) lruTail = slot;
+    }
+
+    void Touch(int slot) {
+        if (lruHead == slot) return;
+        Unlink(slot);
+        PushFront(slot);
+    }
+
+#ifndef __EMSCRIPTEN__
+    // Reads pages in request order; the file is only touched here once Open returns
+    void LoaderLoop() {
+        while (true) {
+            int page;
+            {
+                std::unique_lock<std::mutex> lock(queueMutex);
+                queueCondition.wait(lock, [this] { return stopping || !requests.empty(); });
+                if (stopping) return;
+                page = requests.front();
+                requests.pop_front();
+            }
+            std::vector<Color> texels;
+            LoadPage(page, texels);
+            std::unique_lock<std::mutex> lock(queueMutex);
+            completed.emplace_back(page, std::move(texels));
+        }
+    }
+#endif
+
+    static std::vector<Color> Downsample(const std::vector<Color>& source, int width, int height) {
+        int w = std::max(1, width / 2), h = std::max(1, height / 2);
+        std::vector<Color> result((size_t)w * h);
+        for (int y = 0; y < h; y++) {
+            for (int x = 0; x < w; x++) {
+                int x0 = std::min(x * 2, width - 1), x1 = std::min(x * 2 + 1, width - 1);
+                int y0 = std::min(y * 2, height - 1), y1 = std::min(y * 2 + 1, height - 1);
+                const Color& a = source[y0 * width + x0];
+                const Color& b = source[y0 * width + x1];
+                const Color& c = source[y1 * width + x0];
+                const Color& d = source[y1 * width + x1];
+                result[y * w + x] = {(unsigned char)((a.r + b.r + c.r + d.r + 2) / 4), (unsigned char)((a.g + b.g + c.g + d.g + 2) / 4),
+                                     (unsigned char)((a.b + b.b + c.b + d.b + 2) / 4), (unsigned char)((a.a + b.a + c.a + d.a + 2) / 4)};
+            }
+        }
+        return result;
+    }
+
+    FILE* file;
+    int pageSize;
+    int pageShift;             // pageSize is a power of two
+    int pageMask;
+    size_t pageTexels;
+    int capacity;
+    std::vector<Level> levels;
+    int pageCount = 0;
+
+    // Main thread only, and fixed while raster samples
+    std::vector<int> pageSlots;                  // Per page: its cache slot, -1 if not resident
+    std::vector<std::unique_ptr<Color[]>> slotTexels;
+    std::vector<int> slotPages;
+    std::vector<int> lruPrev, lruNext;
+    int lruHead = -1, lruTail = -1;
+    int pinnedSlot = -1;
+    int residentPages = 0;
+    std::vector<bool> inFlight;
+    int inFlightCount = 0;
+    uint32_t version = 0;
+    uint32_t markStamp = 1;
+    std::vector<std::pair<int, std::vector<Color>>> publishing;
+
+    // Written by raster threads
+    std::unique_ptr<std::atomic<uint32_t>[]> marks;    // Per page: the stamp of the last frame to sample it
+
+    std::deque<int> requests;
+#ifndef __EMSCRIPTEN__
+    std::vector<std::pair<int, std::vector<Color>>> completed;
+    std::mutex queueMutex;
+    std::condition_variable queueCondition;
+    bool stopping = false;
+    std::thread loader;
+#endif
+};
@@ -2,24 +2,184 @@
 #include "Renderer.h"
 #include "GameObject.h"
 #include "CameraS.h"
-#include "OBJLoader.h"
-#include "Texture.h"
+#include "AssetManager.h"
 #include <vector>
+#include <string>
+#include <cstring>
+#include <cstdio>
+#include <cmath>
+#include <chrono>
+#include <iostream>
 
 #ifdef __EMSCRIPTEN__
 #include <emscripten/emscripten.h>
+#else
+#include "FrameWriter.h"
 #endif
 
 struct GameState {
     Renderer* renderer;
+    AssetManager* assets;
+    TransformSystem transforms;
     CameraS camera;
     std::vector<GameObject*> objects;
+    std::vector<GameObject*> crowd;    // Skinned columns swaying out of phase
     float timer = 0.0f;
     float speed = 5.0f;
     float rotSpeed = 3.0f;
+    int width = 0;
+    int height = 0;
+    bool splitScreen = false;
+    bool transparent = false;
+    bool post = false;
+    CameraS sideCamera;
 };
 
 GameState* gState = nullptr;
+bool gCompressTextures = false;
+VertexQuantization gVertexQuantization;
+bool gVirtualTextures = false;
+int gCrowdSize = 0;
+std::string gSharedFrames;    // Name of the shared-memory frame ring; empty for none
+
+void ShareFrames() {
+    if (gSharedFrames.empty()) return;
+    if (!gState->renderer->EnableSharedFrames(gSharedFrames)) {
+        fprintf(stderr, "Failed to create shared frame ring %s\n", gSharedFrames.c_str());
+    }
+}
+
+static const int kColumnJoints = 4;
+static const int kColumnRings = 13;
+static const int kColumnSegments = 12;
+static const float kColumnHeight = 1.2f;
+static const float kColumnRadius = 0.15f;
+
+// Stand-in for an animated character: a tube skinned to a chain of joints, plus one
+// morph target that puffs it out
+MeshS MakeSwayingColumn() {
+    MeshS mesh;
+    float jointSpacing = kColumnHeight / kColumnJoints;
+    for (int ring = 0; ring < kColumnRings; ring++) {
+        float y = kColumnHeight * ring / (kColumnRings - 1);
+        float chain = std::min(y / jointSpacing, (float)(kColumnJoints - 1));
+        int joint = std::min((int)chain, kColumnJoints - 2);
+        float blend = chain - joint;
+        for (int segment = 0; segment <= kColumnSegments; segment++) {
+            float angle = 6.2831853f * segment / kColumnSegments;
+            Vector3S normal = {cosf(angle), 0.0f, sinf(angle)};
+            Vertex vertex;
+            vertex.position = {normal.x * kColumnRadius, y, normal.z * kColumnRadius};
+            vertex.normal = normal;
+            vertex.uv = {(float)segment / kColumnSegments, y / kColumnHeight};
+            mesh.vertices.push_back(vertex);
+            mesh.skin.push_back({{(uint8_t)joint, (uint8_t)(joint + 1), 0, 0}, {1.0f - blend, blend, 0.0f, 0.0f}});
+        }
+    }
+    for (int ring = 0; ring + 1 < kColumnRings; ring++) {
+        for (int segment = 0; segment < kColumnSegments; segment++) {
+            int a = ring * (kColumnSegments + 1) + segment;
+            int b = a + kColumnSegments + 1;
+            mesh.indices.insert(mesh.indices.end(), {a, a + 1, b, a + 1, b + 1, b});
+        }
+    }
+    for (int j = 0; j < kColumnJoints; j++) {
+        mesh.inverseBindMatrices.push_back(MatrixMakeTranslation(0.0f, -j * jointSpacing, 0.0f));
+    }
+    MorphTarget puff;
+    for (uint32_t i = 0; i < mesh.vertices.size(); i++) {
+        puff.vertices.push_back(i);
+        puff.positionDeltas.push_back(Vector3Scale(mesh.vertices[i].normal, 0.6f * kColumnRadius));
+    }
+    mesh.morphTargets.push_back(puff);
+    return mesh;
+}
+
+// Each joint bends the chain a little further about z, on top of its parent
+void PoseColumn(GameObject& column, float t) {
+    float jointSpacing = kColumnHeight / kColumnJoints;
+    column.jointTransforms.resize(kColumnJoints);
+    Matrix4x4 parent = Matrix4x4::Identity();
+    for (int j = 0; j < kColumnJoints; j++) {
+        Matrix4x4 local = MultiplyMatrix(MatrixMakeRotationZ(0.25f * sinf(2.0f * t + 0.7f * j)),
+                                         MatrixMakeTranslation(0.0f, j == 0 ? 0.0f : jointSpacing, 0.0f));
+        parent = MultiplyMatrix(local, parent);
+        column.jointTransforms[j] = parent;
+    }
+    column.morphWeights.assign(1, 0.5f + 0.5f * sinf(3.0f * t));
+}
+
+void AnimateObjects(float t) {
+    std::vector<GameObject*>& objects = gState->objects;
+    float pulse = 1.0f + 0.2f * sinf(2.0f * t);
+    objects[0]->transform.SetScale({pulse, pulse, pulse});
+    
+    objects[1]->transform.SetRotation({0.0f, t * 2.0f, 0.0f});
+    
+    Vector3S hop = objects[2]->transform.GetPosition();
+    hop.y = 0.5f * sinf(3.0f * t);
+    objects[2]->transform.SetPosition(hop);
+    
+    objects[3]->transform.SetRotation({t * 1.5f, 0.0f, t * 0.7f});
+    
+    float squash = 1.0f + 0.4f * sinf(4.0f * t);
+    objects[4]->transform.SetScale({1.0f / sqrtf(squash), squash, 1.0f / sqrtf(squash)});
+
+    for (size_t i = 0; i < gState->crowd.size(); i++) {
+        PoseColumn(*gState->crowd[i], t + 0.37f * i);
+    }
+}
+
+// Turns the left-hand pair of objects into half-transparent ghosts
+void SetTransparent(bool transparent) {
+    gState->transparent = transparent;
+    gState->objects[1]->opacity = transparent ? 0.5f : 1.0f;
+    gState->objects[3]->opacity = transparent ? 0.5f : 1.0f;
+}
+
+// Dusk look: blue-grey fog, filmic tone curve, a warm grade, darkened corners, FXAA
+void SetPostEffects(bool enabled) {
+    gState->post = enabled;
+    PostChain chain;
+    if (enabled) {
+        std::shared_ptr<ColorLUT> warm = ColorLUT::MakeIdentity(16);
+        for (Color& texel : warm->texels) {
+            texel.r = (unsigned char)std::min(255, texel.r + 20);
+            texel.b = (unsigned char)(texel.b * 0.85f);
+        }
+        chain.Fog({40, 48, 64, 255}, 0.06f, 6.0f).ToneMap(1.6f).ColorGrade(warm, 0.8f).Vignette(0.45f, 0.4f).FXAA();
+    }
+    gState->renderer->SetPostChain(chain);
+}
+
+void DrawScene() {
+    gState->renderer->Clear(BLACK);
+    if (gState->splitScreen) {
+        // Player camera on the left, fixed side view on the right, rendered in one pass
+        std::vector<ViewS> views(2);
+        views[0].camera = gState->camera;
+        views[0].width = gState->width / 2;
+        views[0].height = gState->height;
+        views[1].camera = gState->sideCamera;
+        views[1].x = views[0].width;
+        views[1].width = gState->width - views[0].width;
+        views[1].height = gState->height;
+        for (auto* obj : gState->objects) {
+            gState->renderer->DrawMeshMultiView(*obj, views);
+        }
+        for (auto* obj : gState->crowd) {
+            gState->renderer->DrawMeshMultiView(*obj, views);
+        }
+    } else {
+        for (auto* obj : gState->objects) {
+            gState->renderer->DrawMesh(*obj, gState->camera);
+        }
+        for (auto* obj : gState->crowd) {
+            gState->renderer->DrawMesh(*obj, gState->camera);
+        }
+    }
+    gState->renderer->Render();
+}
 
 void UpdateFrame() {
     float dt = GetFrameTime();
@@ -29,6 +189,35 @@ void UpdateFrame() {
     if (IsKeyPressed(KEY_THREE)) gState->renderer->SetShadingMode(ShadingMode::Flat);
     if (IsKeyPressed(KEY_FOUR)) gState->renderer->SetShadingMode(ShadingMode::Cel);
     if (IsKeyPressed(KEY_FIVE)) gState->renderer->SetShadingMode(ShadingMode::Unlit);
+    if (IsKeyPressed(KEY_M)) {
+        AntiAliasing mode = gState->renderer->GetAntiAliasing() == AntiAliasing::MSAA4x ? AntiAliasing::None : AntiAliasing::MSAA4x;
+        gState->renderer->SetAntiAliasing(mode);
+    }
+    if (IsKeyPressed(KEY_R)) {
+        gState->renderer->SetDynamicResolution(!gState->renderer->IsDynamicResolutionEnabled());
+    }
+    if (IsKeyPressed(KEY_I)) {
+        gState->renderer->SetIncrementalRendering(!gState->renderer->IsIncrementalRenderingEnabled());
+    }
+    if (IsKeyPressed(KEY_V)) gState->splitScreen = !gState->splitScreen;
+    if (IsKeyPressed(KEY_T)) SetTransparent(!gState->transparent);
+    if (IsKeyPressed(KEY_F)) SetPostEffects(!gState->post);
+    if (IsKeyPressed(KEY_H)) {
+        ShadowQuality quality = gState->renderer->GetShadowQuality();
+        quality = quality == ShadowQuality::Off ? ShadowQuality::Hard :
+                  quality == ShadowQuality::Hard ? ShadowQuality::PCF3x3 : ShadowQuality::Off;
+        gState->renderer->SetShadowQuality(quality);
+    }
+    if (IsKeyPressed(KEY_C)) {
+        PerspectiveCorrection mode = gState->renderer->GetPerspectiveCorrection();
+        mode = mode == PerspectiveCorrection::Exact ? PerspectiveCorrection::Span8 :
+               mode == PerspectiveCorrection::Span8 ? PerspectiveCorrection::Span16 : PerspectiveCorrection::Exact;
+        gState->renderer->SetPerspectiveCorrection(mode);
+    }
+    if (IsKeyPressed(KEY_P)) {
+        FrameMode mode = gState->renderer->GetFrameMode() == FrameMode::Pipelined ? FrameMode::LowLatency : FrameMode::Pipelined;
+        gState->renderer->SetFrameMode(mode);
+    }
     
     Vector3S right = {gState->camera.rotationMatrix.m[0][0], gState->camera.rotationMatrix.m[0][1], gState->camera.rotationMatrix.m[0][2]};
     Vector3S up = {gState->camera.rotationMatrix.m[1][0], gState->camera.rotationMatrix.m[1][1], gState->camera.rotationMatrix.m[1][2]};
@@ -57,49 +246,31 @@ void UpdateFrame() {
         gState->camera.rotationMatrix = MultiplyMatrix(pitchMat, yawMat);
     }
 
-    float t = gState->timer;
-    
-    gState->objects[0]->transform.scale = {1.0f + 0.2f * sinf(2.0f * t), 1.0f + 0.2f * sinf(2.0f * t), 1.0f + 0.2f * sinf(2.0f * t)};
-    
-    gState->objects[1]->transform.rotation.y = t * 2.0f;
-    
-    gState->objects[2]->transform.position.y = 0.5f * sinf(3.0f * t);
-    
-    gState->objects[3]->transform.rotation.x = t * 1.5f;
-    gState->objects[3]->transform.rotation.z = t * 0.7f;
-    
-    float squash = 1.0f + 0.4f * sinf(4.0f * t);
-    gState->objects[4]->transform.scale = {1.0f / sqrtf(squash), squash, 1.0f / sqrtf(squash)};
+    AnimateObjects(gState->timer);
     
     gState->timer = fmod(gState->timer + dt, 1000000.0f);
     
-    gState->renderer->Clear(BLACK);
-    for (auto* obj : gState->objects) {
-        gState->renderer->DrawMesh(*obj, gState->camera);
-    }
-    gState->renderer->Render();
+    DrawScene();
+    // Between frames: swap in whatever finished loading
+    gState->assets->Update();
 }
 
-int main() {
-    const int width = 800;
-    const int height = 450;
-
-    InitWindow(width, height, "C++ Software Renderer");
-    SetTargetFPS(0);
-
-    gState = new GameState();
-    gState->renderer = new Renderer(width, height);
-    gState->camera.position = {0, 0, -5.0f};
-
-    MeshS loadedMesh;
-    if (!ObjLoader::LoadOBJ("models/Chicken.obj", loadedMesh)) {
-        TraceLog(LOG_ERROR, "Failed to load OBJ file");
-        CloseWindow();
-        return -1;
+// Only queues the loads: objects draw with placeholders until their assets arrive
+void LoadScene() {
+    gState->assets->SetTextureCompression(gCompressTextures);
+    gState->assets->SetVertexQuantization(gVertexQuantization);
+    MeshHandle mesh = gState->assets->LoadMesh("models/Chicken.obj", 1);
+    std::string texturePath = "models/ChickenTexture.png";
+    if (gVirtualTextures) {
+        // Tiled once, next to the image. The demo texture is small, so its pages are
+        // too: enough of them to see pages stream in.
+        std::string tiledPath = "models/ChickenTexture.vtex";
+        FILE* existing = fopen(tiledPath.c_str(), "rb");
+        if (existing) fclose(existing);
+        if (existing || VirtualTexture::Build(texturePath, tiledPath, 64)) texturePath = tiledPath;
+        else fprintf(stderr, "Failed to write %s; using the plain texture\n", tiledPath.c_str());
     }
-
-    static TextureS monkeyTexture;
-    bool hasLoaded = monkeyTexture.Load("models/ChickenTexture.png");
+    TextureHandle texture = gState->assets->LoadTexture(texturePath);
 
     Vector3S positions[] = {
         {0.0f, 0.0f, 0.0f},
@@ -110,14 +281,467 @@ int main() {
     };
     
     for (int i = 0; i < 5; i++) {
-        GameObject* obj = new GameObject(loadedMesh);
-        obj->transform.position = positions[i];
-        if (hasLoaded) {
-            obj->texture = &monkeyTexture;
-        }
+        GameObject* obj = new GameObject(gState->transforms, mesh);
+        obj->transform.SetPosition(positions[i]);
+        obj->texture = texture;
         gState->objects.push_back(obj);
     }
 
+    // The crowd stands on a square grid around the middle of the scene
+    if (gCrowdSize > 0) {
+        MeshHandle column = gState->assets->AddMesh(MakeSwayingColumn());
+        int side = (int)ceilf(sqrtf((float)gCrowdSize));
+        for (int i = 0; i < gCrowdSize; i++) {
+            GameObject* obj = new GameObject(gState->transforms, column);
+            obj->transform.SetPosition({((i % side) - 0.5f * (side - 1)) * 0.6f, -1.5f, 3.0f + ((i / side) - 0.5f * (side - 1)) * 0.6f});
+            obj->texture = texture;
+            gState->crowd.push_back(obj);
+        }
+    }
+}
+
+void DestroyScene() {
+    for (auto* obj : gState->objects) {
+        delete obj;
+    }
+    for (auto* obj : gState->crowd) {
+        delete obj;
+    }
+    delete gState->renderer;
+    delete gState->assets;   // After the renderer: a frame in flight may still read assets
+    delete gState;
+    gState = nullptr;
+}
+
+#ifndef __EMSCRIPTEN__
+struct OfflineOptions {
+    std::string output;
+    FrameFormat format = FrameFormat::Y4M;
+    bool formatSet = false;
+    int frames = 120;
+    int fps = 30;
+    int width = 800;
+    int height = 450;
+    bool pipelined = true;
+    PerspectiveCorrection perspective = PerspectiveCorrection::Exact;
+    bool meshletCulling = true;
+    bool transparent = false;
+    bool post = false;
+    ShadowQuality shadows = ShadowQuality::Off;
+    bool cpuCheck = false;
+    bool threadCheck = false;
+    bool spanCheck = false;
+};
+
+bool EndsWith(const std::string& s, const char* suffix) {
+    size_t n = strlen(suffix);
+    return s.size() >= n && s.compare(s.size() - n, n, suffix) == 0;
+}
+
+// Headless renderer and scene with every asset loaded; false (and no scene) if they fail to load
+bool LoadOfflineScene(const OfflineOptions& options) {
+    gState = new GameState();
+    gState->renderer = new Renderer(options.width, options.height, true);
+    gState->width = options.width;
+    gState->height = options.height;
+    gState->renderer->SetFrameMode(options.pipelined ? FrameMode::Pipelined : FrameMode::LowLatency);
+    gState->renderer->SetPerspectiveCorrection(options.perspective);
+    gState->renderer->SetMeshletCulling(options.meshletCulling);
+    gState->renderer->SetShadowQuality(options.shadows);
+    ShareFrames();
+    gState->assets = new AssetManager();
+    LoadScene();
+    SetTransparent(options.transparent);
+    SetPostEffects(options.post);
+    // A video should not start with placeholders
+    gState->assets->WaitAll();
+    gState->assets->Update();
+    if (gState->objects[0]->mesh.GetState() != AssetState::Ready) {
+        DestroyScene();
+        return false;
+    }
+    return true;
+}
+
+// Frame of the turntable: the camera circles the scene once over frames
+void PlaceTurntableCamera(int frame, int frames) {
+    const Vector3S center = {0.0f, 0.0f, 3.0f};
+    const float radius = 11.0f;
+    float angle = 6.2831853f * frame / frames;
+    gState->camera.yaw = angle;
+    gState->camera.pitch = 0.0f;
+    gState->camera.rotationMatrix = MatrixMakeRotationY(angle);
+    gState->camera.position = {center.x + radius * sinf(angle), center.y, center.z - radius * cosf(angle)};
+}
+
+void PrintUsage();
+
+// Renders a turntable of the demo scene with no window and no frame limiter,
+// streaming every frame through a background FrameWriter
+int RunOffline(OfflineOptions options) {
+    if (!options.formatSet) {
+        if (EndsWith(options.output, ".ppm")) options.format = FrameFormat::PPM;
+        else if (EndsWith(options.output, ".y4m")) options.format = FrameFormat::Y4M;
+        else options.format = FrameFormat::RawRGBA;
+    }
+    if (options.format == FrameFormat::PPM && !FrameWriter::IsValidPPMPattern(options.output)) {
+        fprintf(stderr, "PPM output needs one frame number conversion, %%d or %%0Nd, with %%%% for a literal %%: %s\n",
+                options.output.c_str());
+        PrintUsage();
+        return -1;
+    }
+
+    if (options.output == "-") {
+        // stdout carries the frame stream: keep loader and raylib logging off it
+        std::cout.rdbuf(std::cerr.rdbuf());
+        SetTraceLogLevel(LOG_NONE);
+    }
+
+    if (!LoadOfflineScene(options)) return -1;
+
+    FrameWriter writer(options.output, options.format, options.width, options.height, options.fps);
+    if (!writer.Open()) {
+        DestroyScene();
+        return -1;
+    }
+    gState->renderer->SetFrameSink([&writer](const Color* pixels, int, int) {
+        writer.Submit(pixels);
+    });
+
+    const float dt = 1.0f / options.fps;
+    auto start = std::chrono::steady_clock::now();
+
+    for (int frame = 0; frame < options.frames; frame++) {
+        // A full disk or closed pipe drops every later frame; stop instead of rendering them
+        if (writer.HasFailed()) break;
+        PlaceTurntableCamera(frame, options.frames);
+        AnimateObjects(frame * dt);
+        DrawScene();
+    }
+    gState->renderer->Finish();
+    writer.Close();
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    fprintf(stderr, "Rendered %d frames in %.2fs (%.1f fps)\n", writer.GetFramesWritten(), seconds,
+            writer.GetFramesWritten() / std::max(seconds, 1e-6));
+    BinStats bins = gState->renderer->GetBinStats();
+    fprintf(stderr, "Peak %zu triangles, %zu bin chunks per frame; %.1f MB of bin storage reserved\n",
+            bins.peakTriangles, bins.peakBinChunks, bins.reservedBytes / (1024.0 * 1024.0));
+    GeometryStats geometry = gState->renderer->GetGeometryStats();
+    fprintf(stderr, "Meshlets: %.1f%% outside the view, %.1f%% back-facing; %.1f%% of vertices shaded\n",
+            100.0 * geometry.frustumCulled / std::max<size_t>(1, geometry.meshlets),
+            100.0 * geometry.backfaceCulled / std::max<size_t>(1, geometry.meshlets),
+            100.0 * geometry.shadedVertices / std::max<size_t>(1, geometry.meshVertices));
+    fprintf(stderr, "Textures: %.1f KB%s\n", gState->assets->GetTextureMemory() / 1024.0,
+            gVirtualTextures ? " (virtual, resident pages only)" : gCompressTextures ? " (BC1)" : "");
+    fprintf(stderr, "Mesh vertices: %.1f KB%s\n", gState->assets->GetMeshMemory() / 1024.0,
+            !gVertexQuantization.enabled ? "" :
+            gVertexQuantization.normals == NormalEncoding::Oct8 ? " (quantized, 8-bit normals)" : " (quantized, 16-bit normals)");
+
+    DestroyScene();
+    return writer.HasFailed() ? -1 : 0;
+}
+
+// Checks load the scene with plain textures: virtual texture pages arrive when the disk
+// delivers them, so frames would differ run to run
+bool LoadCheckScene(const OfflineOptions& options, const char* check) {
+    if (gVirtualTextures) {
+        fprintf(stderr, "%s renders with plain textures; ignoring --virtual-textures\n", check);
+        gVirtualTextures = false;
+    }
+    return LoadOfflineScene(options);
+}
+
+// Appends an FNV-1a hash of every frame the renderer finishes
+void HashFrames(std::vector<uint64_t>& hashes) {
+    gState->renderer->SetFrameSink([&hashes](const Color* pixels, int width, int height) {
+        uint64_t hash = 14695981039346656037ull;
+        const unsigned char* bytes = (const unsigned char*)pixels;
+        for (size_t i = 0; i < (size_t)width * height * sizeof(Color); i++) {
+            hash = (hash ^ bytes[i]) * 1099511628211ull;
+        }
+        hashes.push_back(hash);
+    });
+}
+
+// The turntable the checks compare, alternating between no AA and MSAA
+void RenderCheckTurntable(const OfflineOptions& options) {
+    const float dt = 1.0f / options.fps;
+    for (int frame = 0; frame < options.frames; frame++) {
+        gState->renderer->SetAntiAliasing(frame % 2 ? AntiAliasing::MSAA4x : AntiAliasing::None);
+        PlaceTurntableCamera(frame, options.frames);
+        AnimateObjects(frame * dt);
+        DrawScene();
+    }
+    gState->renderer->Finish();
+}
+
+// Whether a run's frame hashes equal the reference's; mismatch is set to the first that differs
+bool MatchesReference(const std::vector<uint64_t>& reference, const std::vector<uint64_t>& hashes, size_t& mismatch) {
+    mismatch = 0;
+    while (mismatch < reference.size() && mismatch < hashes.size() && reference[mismatch] == hashes[mismatch]) mismatch++;
+    return mismatch == reference.size() && hashes.size() == reference.size();
+}
+
+// Renders the offline turntable once per kernel level this CPU runs and checks every
+// frame matches the scalar kernels' bit for bit
+int RunCpuCheck(OfflineOptions options) {
+    if (!LoadCheckScene(options, "--cpu-check")) return -1;
+
+    std::vector<uint64_t> hashes;
+    HashFrames(hashes);
+    std::vector<uint64_t> reference;
+    int failed = 0;
+    for (int level = (int)CpuLevel::Scalar; level <= (int)DetectCpuLevel(); level++) {
+        gState->renderer->SetCpuLevel((CpuLevel)level);
+        hashes.clear();
+        RenderCheckTurntable(options);
+
+        if (level == (int)CpuLevel::Scalar) {
+            reference = hashes;
+            fprintf(stderr, "%-8s %zu frames rendered\n", CpuLevelName((CpuLevel)level), hashes.size());
+            continue;
+        }
+        size_t mismatch;
+        if (MatchesReference(reference, hashes, mismatch)) {
+            fprintf(stderr, "%-8s identical\n", CpuLevelName((CpuLevel)level));
+        } else {
+            fprintf(stderr, "%-8s differs from Scalar at frame %zu\n", CpuLevelName((CpuLevel)level), mismatch);
+            failed++;
+        }
+    }
+
+    DestroyScene();
+    return failed ? 1 : 0;
+}
+
+// Renders the offline turntable on one worker and then on several, which cuts the screen
+// into different jobs, and checks every frame matches the single-threaded ones bit for bit
+int RunThreadCheck(OfflineOptions options) {
+    if (!LoadCheckScene(options, "--thread-check")) return -1;
+
+    std::vector<uint64_t> hashes;
+    HashFrames(hashes);
+    std::vector<uint64_t> reference;
+    int failed = 0;
+    for (int threads : {1, 2, 3, 8}) {
+        gState->renderer->SetThreadCount(threads);
+        hashes.clear();
+        RenderCheckTurntable(options);
+
+        if (threads == 1) {
+            reference = hashes;
+            fprintf(stderr, "1 thread   %zu frames rendered\n", hashes.size());
+            continue;
+        }
+        size_t mismatch;
+        if (MatchesReference(reference, hashes, mismatch)) {
+            fprintf(stderr, "%d threads  identical\n", threads);
+        } else {
+            fprintf(stderr, "%d threads  differ from 1 thread at frame %zu\n", threads, mismatch);
+            failed++;
+        }
+    }
+
+    DestroyScene();
+    return failed ? 1 : 0;
+}
+
+// Renders each turntable frame with exact perspective and then with 8- and 16-pixel spans,
+// and fails if any span frame falls below kMinSpanPSNR against the exact one
+const double kMinSpanPSNR = 40.0;
+
+int RunSpanCheck(OfflineOptions options) {
+    if (!LoadCheckScene(options, "--span-check")) return -1;
+
+    const PerspectiveCorrection modes[] = {PerspectiveCorrection::Exact, PerspectiveCorrection::Span8, PerspectiveCorrection::Span16};
+    std::vector<Color> exact;
+    double minPSNR[3] = {INFINITY, INFINITY, INFINITY};
+    double sumPSNR[3] = {};
+    int rendered = 0;
+    gState->renderer->SetFrameSink([&](const Color* pixels, int width, int height) {
+        // Frames arrive in submission order: exact, then each span length
+        int mode = rendered++ % 3;
+        size_t count = (size_t)width * height;
+        if (mode == 0) {
+            exact.assign(pixels, pixels + count);
+            return;
+        }
+        double squared = 0.0;
+        for (size_t i = 0; i < count; i++) {
+            int dr = pixels[i].r - exact[i].r, dg = pixels[i].g - exact[i].g, db = pixels[i].b - exact[i].b;
+            squared += dr * dr + dg * dg + db * db;
+        }
+        double mse = squared / (count * 3);
+        double psnr = mse > 0.0 ? 10.0 * log10(255.0 * 255.0 / mse) : 99.0;    // Capped for identical frames
+        minPSNR[mode] = std::min(minPSNR[mode], psnr);
+        sumPSNR[mode] += psnr;
+    });
+
+    const float dt = 1.0f / options.fps;
+    for (int frame = 0; frame < options.frames; frame++) {
+        gState->renderer->SetAntiAliasing(frame % 2 ? AntiAliasing::MSAA4x : AntiAliasing::None);
+        PlaceTurntableCamera(frame, options.frames);
+        AnimateObjects(frame * dt);
+        for (PerspectiveCorrection mode : modes) {
+            gState->renderer->SetPerspectiveCorrection(mode);
+            DrawScene();
+        }
+    }
+    gState->renderer->Finish();
+
+    int failed = 0;
+    for (int mode = 1; mode < 3; mode++) {
+        bool passed = minPSNR[mode] >= kMinSpanPSNR;
+        fprintf(stderr, "%-7s PSNR against exact: min %.1f dB, mean %.1f dB%s\n", mode == 1 ? "Span8" : "Span16",
+                minPSNR[mode], sumPSNR[mode] / options.frames, passed ? "" : " (below the limit)");
+        if (!passed) failed++;
+    }
+
+    DestroyScene();
+    return failed ? 1 : 0;
+}
+
+void PrintUsage() {
+    fprintf(stderr,
+        "Usage: SoftwareRenderer [--offline <output|->] [--frames N] [--fps N]\n"
+        "                        [--format raw|ppm|y4m] [--size WxH] [--low-latency]\n"
+        "                        [--compress-textures] [--perspective-span 8|16]\n"
+        "                        [--shared-frames <name>] [--no-meshlet-culling] [--transparent]\n"
+        "                        [--crowd N] [--post] [--cpu-check] [--quantize-vertices 8|16]\n"
+        "                        [--virtual-textures] [--shadows hard|pcf] [--thread-check]\n"
+        "                        [--span-check]\n"
+        "  --offline writes a headless turntable; PPM output takes a pattern like out/frame_%%05d.ppm,\n"
+        "            with one %%d or %%0Nd and any other %% written as %%%%\n"
+        "  --compress-textures keeps textures BC1-compressed and decodes them while sampling\n"
+        "  --quantize-vertices packs static meshes into 16-bit positions and UVs and\n"
+        "                      octahedral normals of 8 or 16 bits per component\n"
+        "  --virtual-textures tiles the scene texture into models/*.vtex and pages it in as it is seen\n"
+        "  --perspective-span divides by w every 8 or 16 pixels and interpolates linearly between\n"
+        "  --shared-frames renders into POSIX shared memory /<name> for SharedFrameReader clients\n"
+        "  --transparent draws two of the objects half transparent\n"
+        "  --crowd adds N skinned, morphing columns to the scene\n"
+        "  --shadows renders the turntable with hard or 3x3 PCF shadow maps\n"
+        "  --post applies the demo post chain: fog, tone mapping, grading, vignette, FXAA\n"
+        "  --cpu-check renders the turntable with each kernel instruction set the CPU supports\n"
+        "              and fails unless all match; RENDERER_CPU=scalar|sse2|avx2|avx512 caps it\n"
+        "  --thread-check renders the turntable on 1, 2, 3 and 8 threads and fails unless all match\n"
+        "  --span-check fails if --perspective-span 8 or 16 falls below 40 dB PSNR against exact\n");
+}
+#endif
+
+int main(int argc, char** argv) {
+#ifndef __EMSCRIPTEN__
+    OfflineOptions offline;
+    bool runOffline = false;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--offline" && hasValue) {
+            runOffline = true;
+            offline.output = argv[++i];
+        } else if (arg == "--frames" && hasValue) {
+            offline.frames = std::max(1, atoi(argv[++i]));
+        } else if (arg == "--fps" && hasValue) {
+            offline.fps = std::max(1, atoi(argv[++i]));
+        } else if (arg == "--format" && hasValue) {
+            std::string format = argv[++i];
+            if (format != "raw" && format != "ppm" && format != "y4m") {
+                PrintUsage();
+                return -1;
+            }
+            offline.formatSet = true;
+            offline.format = format == "ppm" ? FrameFormat::PPM : format == "y4m" ? FrameFormat::Y4M : FrameFormat::RawRGBA;
+        } else if (arg == "--size" && hasValue) {
+            if (sscanf(argv[++i], "%dx%d", &offline.width, &offline.height) != 2 || offline.width <= 0 || offline.height <= 0) {
+                PrintUsage();
+                return -1;
+            }
+        } else if (arg == "--low-latency") {
+            offline.pipelined = false;
+        } else if (arg == "--compress-textures") {
+            gCompressTextures = true;
+        } else if (arg == "--quantize-vertices" && hasValue) {
+            std::string bits = argv[++i];
+            if (bits != "8" && bits != "16") {
+                PrintUsage();
+                return -1;
+            }
+            gVertexQuantization.enabled = true;
+            gVertexQuantization.normals = bits == "8" ? NormalEncoding::Oct8 : NormalEncoding::Oct16;
+        } else if (arg == "--virtual-textures") {
+            gVirtualTextures = true;
+        } else if (arg == "--no-meshlet-culling") {
+            offline.meshletCulling = false;
+        } else if (arg == "--crowd" && hasValue) {
+            gCrowdSize = std::max(0, atoi(argv[++i]));
+        } else if (arg == "--post") {
+            offline.post = true;
+        } else if (arg == "--shadows" && hasValue) {
+            std::string quality = argv[++i];
+            if (quality != "hard" && quality != "pcf") {
+                PrintUsage();
+                return -1;
+            }
+            offline.shadows = quality == "hard" ? ShadowQuality::Hard : ShadowQuality::PCF3x3;
+        } else if (arg == "--cpu-check") {
+            offline.cpuCheck = true;
+        } else if (arg == "--thread-check") {
+            offline.threadCheck = true;
+        } else if (arg == "--span-check") {
+            offline.spanCheck = true;
+        } else if (arg == "--transparent") {
+            offline.transparent = true;
+        } else if (arg == "--shared-frames" && hasValue) {
+            gSharedFrames = argv[++i];
+        } else if (arg == "--perspective-span" && hasValue) {
+            int span = atoi(argv[++i]);
+            if (span != 8 && span != 16) {
+                PrintUsage();
+                return -1;
+            }
+            offline.perspective = span == 8 ? PerspectiveCorrection::Span8 : PerspectiveCorrection::Span16;
+        } else {
+            PrintUsage();
+            return -1;
+        }
+    }
+    if (offline.cpuCheck) {
+        return RunCpuCheck(offline);
+    }
+    if (offline.threadCheck) {
+        return RunThreadCheck(offline);
+    }
+    if (offline.spanCheck) {
+        return RunSpanCheck(offline);
+    }
+    if (runOffline) {
+        return RunOffline(offline);
+    }
+#else
+    (void)argc;
+    (void)argv;
+#endif
+
+    const int width = 800;
+    const int height = 450;
+
+    InitWindow(width, height, "C++ Software Renderer");
+    SetTargetFPS(0);
+
+    gState = new GameState();
+    gState->renderer = new Renderer(width, height);
+    gState->renderer->SetShadowQuality(ShadowQuality::PCF3x3);  // H cycles it
+    ShareFrames();
+    gState->width = width;
+    gState->height = height;
+    gState->camera.position = {0, 0, -5.0f};
+    gState->sideCamera.yaw = -1.5707963f;
+    gState->sideCamera.rotationMatrix = MatrixMakeRotationY(gState->sideCamera.yaw);
+    gState->sideCamera.position = {-11.0f, 0.0f, 3.0f};
+    gState->assets = new AssetManager();
+    LoadScene();
+
 #ifdef __EMSCRIPTEN__
     emscripten_set_main_loop(UpdateFrame, 0, 1);
 #else
@@ -126,11 +750,7 @@ int main() {
     }
 #endif
 
-    for (auto* obj : gState->objects) {
-        delete obj;
-    }
-    delete gState->renderer;
-    delete gState;
+    DestroyScene();
     CloseWindow();
     return 0;
 }
\ No newline at end of file